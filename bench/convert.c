@@ -0,0 +1,106 @@
+/** @copyright 2025 Sean Kasun */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <gmp.h>
+#include "calculator.h"
+#include "convert.h"
+#include "output.h"
+
+/**
+ * Converts a hex dump of 64 bit words to decimal and a column of decimal
+ * numbers to hex, once with convertStream() and once a line at a time
+ * through calculate() and printValue(), the way piping the same numbers
+ * through zx would.  Prints the throughput of each and fails if their
+ * output differs.
+ *
+ *   zx_convert_bench [megabytes]
+ */
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *generate(size_t size, int base, size_t *len) {
+  gmp_randstate_t rand;
+  gmp_randinit_default(rand);
+  char *buf = NULL;
+  FILE *out = open_memstream(&buf, len);
+  mpz_t z;
+  mpz_init(z);
+  while (ftell(out) < (long)size) {
+    mpz_urandomb(z, rand, 64);
+    mpz_out_str(out, base, z);
+    fputc('\n', out);
+  }
+  mpz_clear(z);
+  fclose(out);
+  gmp_randclear(rand);
+  return buf;
+}
+
+static double viaConvert(const char *input, size_t len, int from, int to, char **output,
+                         size_t *outputLen) {
+  double start = now();
+  FILE *in = fmemopen((char *)input, len, "r");
+  FILE *out = open_memstream(output, outputLen);
+  convertStream(in, out, from, to);
+  fclose(in);
+  fclose(out);
+  return now() - start;
+}
+
+static double viaCalculate(const char *input, size_t len, int from, int to, char **output,
+                           size_t *outputLen) {
+  double start = now();
+  FILE *in = fmemopen((char *)input, len, "r");
+  FILE *out = open_memstream(output, outputLen);
+  struct Format format = {.base = to};
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t n;
+  char expr[64];
+  struct Value v;
+  valueInitZ(&v);
+  while ((n = getline(&line, &cap, in)) > 0) {
+    line[n - 1] = 0;
+    snprintf(expr, sizeof(expr), "%s%s", from == 16 ? "0x" : "", line);
+    v = calculate(expr, v);
+    printValue(out, v, &format);
+  }
+  valueClear(&v);
+  free(line);
+  fclose(in);
+  fclose(out);
+  return now() - start;
+}
+
+static int run(const char *name, size_t size, int from, int to) {
+  size_t len;
+  char *input = generate(size, from, &len);
+  char *fast, *slow;
+  size_t fastLen, slowLen;
+  double fastSeconds = viaConvert(input, len, from, to, &fast, &fastLen);
+  double slowSeconds = viaCalculate(input, len, from, to, &slow, &slowLen);
+  double mb = len / 1e6;
+  printf("%-8s %7.1f MB  convert %8.1f MB/s  calculate %6.1f MB/s  %.0fx\n", name, mb,
+         mb / fastSeconds, mb / slowSeconds, slowSeconds / fastSeconds);
+  int bad = fastLen != slowLen || memcmp(fast, slow, fastLen);
+  if (bad) {
+    fprintf(stderr, "error: %s output differs from printValue()\n", name);
+  }
+  free(fast);
+  free(slow);
+  free(input);
+  return bad;
+}
+
+int main(int argc, char **argv) {
+  size_t size = (argc > 1 ? atof(argv[1]) : 16) * 1e6;
+  int bad = run("h:d", size, 16, 10);
+  bad += run("d:h", size, 10, 16);
+  return bad ? 1 : 0;
+}
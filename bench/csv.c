@@ -0,0 +1,80 @@
+/** @copyright 2025 Sean Kasun */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "calculator.h"
+#include "csv.h"
+#include "output.h"
+
+/**
+ * Times zx --csv's runCsv() over random rows of three columns, mostly small
+ * integers with a share that overflow int64, then a shell loop that runs zx
+ * once per row on the first few hundred, and prints rows per second for
+ * each.
+ *
+ *   zx_csv_bench [rows] [shell rows]
+ */
+
+#define FORMULA "$1 * 3 + $2 - $3 / 7"
+#define SHELL_LOOP "while IFS=, read a b c; do " ZX_PATH " \"($a) * 3 + ($b) - ($c) / 7\"; done"
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// every tenth row has a cell that overflows int64 once multiplied
+static void writeRows(FILE *out, int rows) {
+  srand(1);
+  for (int i = 0; i < rows; i++) {
+    if (i % 10 == 9) {
+      fprintf(out, "%d,9000000000000000000,%d\n", rand() % 100000, rand() % 100000);
+    } else {
+      fprintf(out, "%d,%d,%d\n", rand() % 100000, rand() % 100000, rand() % 100000);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  int rows = argc > 1 ? atoi(argv[1]) : 1000000;
+  int shellRows = argc > 2 ? atoi(argv[2]) : 300;
+  char *input = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream(&input, &len);
+  writeRows(out, rows);
+  fclose(out);
+
+  FILE *in = fmemopen(input, len, "r");
+  out = fopen("/dev/null", "w");
+  struct Format format = {.base = 10};
+  double start = now();
+  bool ok = runCsv(in, out, FORMULA, ',', &format);
+  double csvSeconds = now() - start;
+  fclose(in);
+  fclose(out);
+  free(input);
+
+  char path[] = "/tmp/zx_csv_benchXXXXXX";
+  int fd = mkstemp(path);
+  out = fdopen(fd, "w");
+  writeRows(out, shellRows);
+  fclose(out);
+  char command[sizeof(SHELL_LOOP) + sizeof(path) + 32];
+  snprintf(command, sizeof(command), "%s < %s > /dev/null", SHELL_LOOP, path);
+  start = now();
+  ok = ok && system(command) == 0;
+  double shellSeconds = now() - start;
+  remove(path);
+
+  double csvRate = rows / csvSeconds, shellRate = shellRows / shellSeconds;
+  printf("%s\n", FORMULA);
+  printf("--csv       %8d rows %8.3fs %10.0f rows/s\n", rows, csvSeconds, csvRate);
+  printf("shell loop  %8d rows %8.3fs %10.0f rows/s  %.0fx slower\n", shellRows, shellSeconds,
+         shellRate, csvRate / shellRate);
+  if (!ok) {
+    fprintf(stderr, "error: A run failed\n");
+    return 1;
+  }
+  return 0;
+}
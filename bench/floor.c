@@ -0,0 +1,15 @@
+/** @copyright 2025 Sean Kasun */
+#include <math.h>
+#include <stdio.h>
+#include <gmp.h>
+#include <mpfr.h>
+#include <readline/readline.h>
+
+// does nothing, but loads every library zx does, as the baseline for zx_startup
+int main(int argc, char **argv) {
+  (void)argv;
+  if (argc > 1) {  // only here so the linker keeps each library
+    printf("%s %s %s %f\n", gmp_version, mpfr_get_version(), rl_library_version, sqrt(argc));
+  }
+  return 0;
+}
@@ -0,0 +1,86 @@
+/** @copyright 2025 Sean Kasun */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <gmp.h>
+#include "calculator.h"
+#include "mpextras.h"
+
+/**
+ * Works out random lines of float arithmetic, then times printing their
+ * results with mpf_get_str_shortest() against mpf_get_str() with every
+ * digit, which is how floats used to print.  Reports the time per float
+ * and the digits each prints.
+ *
+ *   zx_shortest_bench [floats] [rounds]
+ */
+
+static const int bases[] = {10, 16};
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long seed = 1;
+
+static unsigned pick(unsigned n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (seed >> 33) % n;
+}
+
+// the fastest of rounds, in seconds, and the digits printed
+static double timed(struct Value *values, int count, int rounds, int base, bool shortest,
+                    size_t *digits) {
+  double best = 0;
+  for (int r = 0; r < rounds; r++) {
+    *digits = 0;
+    double start = now();
+    for (int i = 0; i < count; i++) {
+      mp_exp_t exp;
+      char *s = shortest ? mpf_get_str_shortest(&exp, base, values[i].f) :
+        mpf_get_str(NULL, &exp, base, 0, values[i].f);
+      *digits += strlen(s);
+      free(s);
+    }
+    double seconds = now() - start;
+    best = r && best < seconds ? best : seconds;
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 50000;
+  int rounds = argc > 2 ? atoi(argv[2]) : 5;
+  struct Value *values = malloc(count * sizeof(struct Value));
+  char line[128];
+  int have = 0;
+  while (have < count) {
+    // the mix of functions, quotients and powers a float session has
+    snprintf(line, sizeof(line), "sin %u.%06u + cos %u.%05u * %u.%04u / %u.%03u - 2 ** 0.%04u",
+             pick(10), pick(1000000), pick(5), pick(100000), pick(10), pick(10000),
+             1 + pick(3), pick(1000), pick(10000));
+    struct Value v;
+    valueInitZ(&v);
+    v = calculate(line, v);
+    if (v.isF) {
+      values[have++] = v;
+    } else {
+      valueClear(&v);
+    }
+  }
+  for (int b = 0; b < 2; b++) {
+    size_t allDigits, fewest;
+    double all = timed(values, count, rounds, bases[b], false, &allDigits);
+    double shortest = timed(values, count, rounds, bases[b], true, &fewest);
+    printf("base %-2d  every digit %.3fus %zu digits  shortest %.3fus %zu digits\n", bases[b],
+           all / count * 1e6, allDigits, shortest / count * 1e6, fewest);
+  }
+  for (int i = 0; i < count; i++) {
+    valueClear(&values[i]);
+  }
+  free(values);
+  return 0;
+}
@@ -0,0 +1,79 @@
+/** @copyright 2025 Sean Kasun */
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+
+/**
+ * Times exec to exit for a one-shot `zx 0x723 "*" 4`, the way scripts run
+ * it, alongside an empty program that loads the same libraries.  What zx
+ * itself adds on top of the loader is tracked against a target, and the run
+ * fails when the median goes over it.
+ *
+ *   zx_startup [runs] [target us]
+ */
+
+#define TARGET_US 400  // median time zx may take beyond loading its libraries
+
+extern char **environ;
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int byTime(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// microseconds from spawning args[0] to reaping it, or -1 if it failed
+static double timeRun(char **args, posix_spawn_file_actions_t *actions) {
+  double start = now();
+  pid_t pid;
+  int status;
+  if (posix_spawn(&pid, args[0], actions, NULL, args, environ) ||
+      waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+    return -1;
+  }
+  return (now() - start) * 1e6;
+}
+
+int main(int argc, char **argv) {
+  int runs = argc > 1 ? atoi(argv[1]) : 2000;
+  double target = argc > 2 ? atof(argv[2]) : TARGET_US;
+  char *zx[] = {ZX_PATH, "0x723", "*", "4", NULL};
+  char *floor[] = {FLOOR_PATH, NULL};
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+  double *zxUs = malloc(runs * sizeof(double));
+  double *floorUs = malloc(runs * sizeof(double));
+  // interleaved, so both see the same load on the machine
+  for (int i = 0; i < runs; i++) {
+    zxUs[i] = timeRun(zx, &actions);
+    floorUs[i] = timeRun(floor, &actions);
+    if (zxUs[i] < 0 || floorUs[i] < 0) {
+      fprintf(stderr, "error: Can't run %s\n", zxUs[i] < 0 ? zx[0] : floor[0]);
+      return 1;
+    }
+  }
+  posix_spawn_file_actions_destroy(&actions);
+  qsort(zxUs, runs, sizeof(double), byTime);
+  qsort(floorUs, runs, sizeof(double), byTime);
+  double added = zxUs[runs / 2] - floorUs[runs / 2];
+  printf("%d runs, median exec to exit\n", runs);
+  printf("zx            %6.0fus\n", zxUs[runs / 2]);
+  printf("libraries     %6.0fus\n", floorUs[runs / 2]);
+  printf("added by zx   %6.0fus  target %.0fus\n", added, target);
+  free(zxUs);
+  free(floorUs);
+  if (added > target) {
+    fprintf(stderr, "error: zx adds more than the target to startup\n");
+    return 1;
+  }
+  return 0;
+}
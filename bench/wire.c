@@ -0,0 +1,112 @@
+/** @copyright 2025 Sean Kasun */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <gmp.h>
+#include "calculator.h"
+#include "wire.h"
+
+/**
+ * Writes and reads back the same random integers as decimal lines and as
+ * wire records, and prints how long each took.
+ *
+ *   zx_wire_bench [count] [bits]
+ */
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// returns the number of values that didn't come back the same
+static int viaText(mpz_t *values, int count, double *seconds, size_t *bytes) {
+  double start = now();
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream(&buf, &len);
+  for (int i = 0; i < count; i++) {
+    mpz_out_str(out, 10, values[i]);
+    fputc('\n', out);
+  }
+  fclose(out);
+  int bad = 0;
+  FILE *in = fmemopen(buf, len, "r");
+  char *line = NULL;
+  size_t cap = 0;
+  mpz_t v;
+  mpz_init(v);
+  for (int i = 0; i < count && getline(&line, &cap, in) > 0; i++) {
+    gmp_sscanf(line, "%Zd", v);
+    bad += mpz_cmp(v, values[i]) != 0;
+  }
+  mpz_clear(v);
+  free(line);
+  fclose(in);
+  *seconds = now() - start;
+  *bytes = len;
+  free(buf);
+  return bad;
+}
+
+static int viaWire(mpz_t *values, int count, double *seconds, size_t *bytes) {
+  double start = now();
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream(&buf, &len);
+  struct Value v;
+  for (int i = 0; i < count; i++) {
+    v.isF = false;
+    v.z[0] = values[i][0];  // borrowed, not cleared
+    wireWriteValue(out, v);
+  }
+  fclose(out);
+  int bad = 0;
+  FILE *in = fmemopen(buf, len, "r");
+  valueInitZ(&v);
+  char *text;
+  for (int i = 0; i < count; i++) {
+    if (wireRead(in, &v, &text) != WireInt || mpz_cmp(v.z, values[i])) {
+      bad++;
+    }
+  }
+  valueClear(&v);
+  fclose(in);
+  *seconds = now() - start;
+  *bytes = len;
+  free(buf);
+  return bad;
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 200000;
+  int bits = argc > 2 ? atoi(argv[2]) : 2000;
+  gmp_randstate_t rand;
+  gmp_randinit_default(rand);
+  mpz_t *values = malloc(count * sizeof(mpz_t));
+  for (int i = 0; i < count; i++) {
+    mpz_init(values[i]);
+    mpz_urandomb(values[i], rand, bits);
+    if (i & 1) {
+      mpz_neg(values[i], values[i]);
+    }
+  }
+  double textSeconds, wireSeconds;
+  size_t textBytes, wireBytes;
+  int bad = viaText(values, count, &textSeconds, &textBytes);
+  bad += viaWire(values, count, &wireSeconds, &wireBytes);
+  printf("%d values of %d bits\n", count, bits);
+  printf("text %8.3fs %10zu bytes\n", textSeconds, textBytes);
+  printf("wire %8.3fs %10zu bytes  %.1fx faster\n", wireSeconds, wireBytes,
+         textSeconds / wireSeconds);
+  for (int i = 0; i < count; i++) {
+    mpz_clear(values[i]);
+  }
+  free(values);
+  gmp_randclear(rand);
+  if (bad) {
+    fprintf(stderr, "error: %d values didn't round-trip\n", bad);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,75 @@
+/** @copyright 2025 Sean Kasun */
+#include "bits.h"
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+/*
+ * The build targets baseline x86-64, so POPCNT and BMI2 are compiled into
+ * functions of their own and only called when the CPU has them.
+ */
+#ifdef __x86_64__
+__attribute__((target("popcnt"))) static int countPopcnt(uint64_t x) {
+  return __builtin_popcountll(x);
+}
+
+__attribute__((target("bmi2"))) static uint64_t depositBmi2(uint64_t x, uint64_t mask) {
+  return _pdep_u64(x, mask);
+}
+
+__attribute__((target("bmi2"))) static uint64_t extractBmi2(uint64_t x, uint64_t mask) {
+  return _pext_u64(x, mask);
+}
+#endif
+
+// the number of set bits in x
+int bitsCount(uint64_t x) {
+#ifdef __x86_64__
+  if (__builtin_cpu_supports("popcnt")) {
+    return countPopcnt(x);
+  }
+#endif
+  return __builtin_popcountll(x);
+}
+
+/**
+ * Scatters the low bits of x, lowest first, to the set bits of mask.
+ * One instruction with BMI2, otherwise a step per set bit of mask.
+ */
+uint64_t bitsDeposit(uint64_t x, uint64_t mask) {
+#ifdef __x86_64__
+  if (__builtin_cpu_supports("bmi2")) {
+    return depositBmi2(x, mask);
+  }
+#endif
+  uint64_t r = 0;
+  for (uint64_t bit = 1; mask; mask &= mask - 1, bit <<= 1) {
+    if (x & bit) {
+      r |= mask & -mask;
+    }
+  }
+  return r;
+}
+
+// gathers the bits of x under the set bits of mask into the low bits
+uint64_t bitsExtract(uint64_t x, uint64_t mask) {
+#ifdef __x86_64__
+  if (__builtin_cpu_supports("bmi2")) {
+    return extractBmi2(x, mask);
+  }
+#endif
+  uint64_t r = 0;
+  for (uint64_t bit = 1; mask; mask &= mask - 1, bit <<= 1) {
+    if (x & mask & -mask) {
+      r |= bit;
+    }
+  }
+  return r;
+}
+
+uint64_t bitsReverse(uint64_t x) {
+  x = __builtin_bswap64(x);
+  x = (x >> 4 & 0x0f0f0f0f0f0f0f0full) | (x & 0x0f0f0f0f0f0f0f0full) << 4;
+  x = (x >> 2 & 0x3333333333333333ull) | (x & 0x3333333333333333ull) << 2;
+  return (x >> 1 & 0x5555555555555555ull) | (x & 0x5555555555555555ull) << 1;
+}
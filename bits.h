@@ -0,0 +1,9 @@
+/** @copyright 2025 Sean Kasun */
+#pragma once
+
+#include <stdint.h>
+
+extern int bitsCount(uint64_t x);
+extern uint64_t bitsDeposit(uint64_t x, uint64_t mask);
+extern uint64_t bitsExtract(uint64_t x, uint64_t mask);
+extern uint64_t bitsReverse(uint64_t x);
@@ -1,7 +1,20 @@
 /** @copyright 2025 Sean Kasun */
 #include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "btree.h"
 
+#define MIN_KEYS (BTREE_ORDER / 2 - 1)
+
+struct Entry {
+  uint32_t prefix;
+  uint32_t len;
+  char *key;
+  void *data;
+};
+
 static struct BTreeNode *newNode(bool leaf) {
   struct BTreeNode *node = malloc(sizeof(struct BTreeNode));
   node->numKeys = 0;
@@ -12,6 +25,90 @@ static struct BTreeNode *newNode(bool leaf) {
   return node;
 }
 
+struct BTreeKey bTreeIntKey(uint32_t key) {
+  struct BTreeKey k = {key, 4, NULL};
+  return k;
+}
+
+struct BTreeKey bTreeStrKey(const char *str, uint32_t len) {
+  struct BTreeKey k = {0, len, str};
+  for (uint32_t i = 0; i < 4; i++) {
+    k.prefix = (k.prefix << 8) | (i < len ? (uint8_t)str[i] : 0);
+  }
+  return k;
+}
+
+int bTreeCompare(struct BTreeKey a, struct BTreeKey b) {
+  if (a.prefix != b.prefix) {
+    return a.prefix < b.prefix ? -1 : 1;
+  }
+  if (a.len > 4 && b.len > 4) {
+    int c = memcmp(a.str + 4, b.str + 4, (a.len < b.len ? a.len : b.len) - 4);
+    if (c) {
+      return c;
+    }
+  }
+  return a.len < b.len ? -1 : a.len > b.len;
+}
+
+static struct BTreeKey keyAt(struct BTreeNode *node, int i) {
+  struct BTreeKey k = {node->prefix[i], node->len[i], node->keys[i]};
+  return k;
+}
+
+static struct Entry entryAt(struct BTreeNode *node, int i) {
+  struct Entry e = {node->prefix[i], node->len[i], node->keys[i], node->data[i]};
+  return e;
+}
+
+static void setEntry(struct BTreeNode *node, int i, struct Entry e) {
+  node->prefix[i] = e.prefix;
+  node->len[i] = e.len;
+  node->keys[i] = e.key;
+  node->data[i] = e.data;
+}
+
+static struct Entry newEntry(struct BTreeKey key, void *data) {
+  struct Entry e = {key.prefix, key.len, NULL, data};
+  if (key.len > 4) {
+    e.key = malloc(key.len);
+    memcpy(e.key, key.str, key.len);
+  }
+  return e;
+}
+
+// number of keys whose prefix is below the given one
+static int lowerBound(struct BTreeNode *node, uint32_t prefix) {
+  int i = 0;
+#ifdef __SSE2__
+  // sse2 only compares signed, so flip the sign bits first
+  __m128i bias = _mm_set1_epi32(0x80000000);
+  __m128i key = _mm_xor_si128(_mm_set1_epi32(prefix), bias);
+  for (; i + 4 <= (int)node->numKeys; i += 4) {
+    __m128i keys = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(node->prefix + i)), bias);
+    int less = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(keys, key)));
+    if (less != 0xf) {
+      return i + __builtin_popcount(less);
+    }
+  }
+#endif
+  while (i < (int)node->numKeys && node->prefix[i] < prefix) {
+    i++;
+  }
+  return i;
+}
+
+// index of the first key not below key
+static int findIndex(struct BTreeNode *node, struct BTreeKey key, bool *found) {
+  int i = lowerBound(node, key.prefix);
+  int c = 1;
+  while (i < (int)node->numKeys && (c = bTreeCompare(keyAt(node, i), key)) < 0) {
+    i++;
+  }
+  *found = i < (int)node->numKeys && c == 0;
+  return i;
+}
+
 static void splitChild(struct BTreeNode *parent, int index) {
   struct BTreeNode *child = parent->children[index];
   struct BTreeNode *node = newNode(child->leaf);
@@ -20,8 +117,7 @@ static void splitChild(struct BTreeNode *parent, int index) {
   node->numKeys = split - 1;
   // move keys and children to new node
   for (int i = 0; i < split - 1; i++) {
-    node->keys[i] = child->keys[i + split];
-    node->data[i] = child->data[i + split];
+    setEntry(node, i, entryAt(child, i + split));
   }
   if (!child->leaf) {
     for (int i = 0; i < split; i++) {
@@ -36,77 +132,300 @@ static void splitChild(struct BTreeNode *parent, int index) {
   parent->children[index + 1] = node;
   // shift parent's keys to make space
   for (int i = parent->numKeys - 1; i >= index; i--) {
-    parent->keys[i + 1] = parent->keys[i];
-    parent->data[i + 1] = parent->data[i];
+    setEntry(parent, i + 1, entryAt(parent, i));
   }
-  parent->keys[index] = child->keys[split - 1];
-  parent->data[index] = child->data[split - 1];
+  setEntry(parent, index, entryAt(child, split - 1));
   parent->numKeys++;
 }
 
-static void insert(struct BTreeNode *node, uint32_t key, void *data) {
-  int i = node->numKeys - 1;
-  if (node->leaf) {
-    while (i >= 0 && node->keys[i] > key) {
-      node->keys[i + 1] = node->keys[i];
-      node->data[i + 1] = node->data[i];
-      i--;
+static void *insert(struct BTreeNode *node, struct BTreeKey key, void *data) {
+  while (true) {
+    bool found;
+    int i = findIndex(node, key, &found);
+    if (found) {
+      void *old = node->data[i];
+      node->data[i] = data;
+      return old;
     }
-    node->keys[i + 1] = key;
-    node->data[i + 1] = data;
-    node->numKeys++;
-  } else {
-    while (i >= 0 && node->keys[i] > key) {
-      i--;
+    if (node->leaf) {
+      for (int j = node->numKeys; j > i; j--) {
+        setEntry(node, j, entryAt(node, j - 1));
+      }
+      setEntry(node, i, newEntry(key, data));
+      node->numKeys++;
+      return NULL;
     }
-    i++;
     if (node->children[i]->numKeys == BTREE_ORDER - 1) {
       splitChild(node, i);
-      if (node->keys[i] < key) {
+      int c = bTreeCompare(keyAt(node, i), key);
+      if (c == 0) {
+        void *old = node->data[i];
+        node->data[i] = data;
+        return old;
+      }
+      if (c < 0) {
         i++;
       }
     }
-    insert(node->children[i], key, data);
+    node = node->children[i];
   }
 }
 
-void bTreeInsert(struct BTreeNode **root, uint32_t key, void *data) {
+/**
+ * Inserts or replaces, the key is copied.  Returns the data it replaced, or
+ * NULL if the key is new.
+ */
+void *bTreePut(struct BTreeNode **root, struct BTreeKey key, void *data) {
   if (*root == NULL) {
-    struct BTreeNode *node = newNode(true);
-    node->keys[0] = key;
-    node->data[0] = data;
-    node->numKeys = 1;
+    *root = newNode(true);
+  }
+  if ((*root)->numKeys == BTREE_ORDER - 1) {
+    struct BTreeNode *node = newNode(false);
+    node->children[0] = *root;
+    splitChild(node, 0);
     *root = node;
-  } else {
-    if ((*root)->numKeys == BTREE_ORDER - 1) {
-      struct BTreeNode *node = newNode(false);
-      node->children[0] = *root;
-      splitChild(node, 0);
-      int i = 0;
-      if (node->keys[0] < key) {
-        i++;
+  }
+  return insert(*root, key, data);
+}
+
+void *bTreeGet(struct BTreeNode *root, struct BTreeKey key) {
+  while (root != NULL) {
+    bool found;
+    int i = findIndex(root, key, &found);
+    if (found) {
+      return root->data[i];
+    }
+    if (root->leaf) {
+      return NULL;
+    }
+    root = root->children[i];
+  }
+  return NULL;
+}
+
+static void removeAt(struct BTreeNode *node, int i) {
+  for (; i + 1 < (int)node->numKeys; i++) {
+    setEntry(node, i, entryAt(node, i + 1));
+    node->children[i + 1] = node->children[i + 2];
+  }
+  node->numKeys--;
+}
+
+// merges child index + 1 and the key between them into child index
+static void merge(struct BTreeNode *node, int index) {
+  struct BTreeNode *left = node->children[index];
+  struct BTreeNode *right = node->children[index + 1];
+  setEntry(left, left->numKeys, entryAt(node, index));
+  for (int i = 0; i < (int)right->numKeys; i++) {
+    setEntry(left, left->numKeys + 1 + i, entryAt(right, i));
+  }
+  if (!left->leaf) {
+    for (int i = 0; i <= (int)right->numKeys; i++) {
+      left->children[left->numKeys + 1 + i] = right->children[i];
+    }
+  }
+  left->numKeys += right->numKeys + 1;
+  removeAt(node, index);
+  free(right);
+}
+
+// makes sure child index has more than the minimum keys, returns where it went
+static int fill(struct BTreeNode *node, int index) {
+  struct BTreeNode *child = node->children[index];
+  if (index > 0 && node->children[index - 1]->numKeys > MIN_KEYS) {
+    // rotate one key in from the left sibling
+    struct BTreeNode *sibling = node->children[index - 1];
+    for (int i = child->numKeys; i > 0; i--) {
+      setEntry(child, i, entryAt(child, i - 1));
+    }
+    for (int i = child->numKeys + 1; i > 0; i--) {
+      child->children[i] = child->children[i - 1];
+    }
+    setEntry(child, 0, entryAt(node, index - 1));
+    child->children[0] = sibling->children[sibling->numKeys];
+    setEntry(node, index - 1, entryAt(sibling, sibling->numKeys - 1));
+    sibling->numKeys--;
+    child->numKeys++;
+    return index;
+  }
+  if (index < (int)node->numKeys && node->children[index + 1]->numKeys > MIN_KEYS) {
+    // rotate one key in from the right sibling
+    struct BTreeNode *sibling = node->children[index + 1];
+    setEntry(child, child->numKeys, entryAt(node, index));
+    child->children[child->numKeys + 1] = sibling->children[0];
+    child->numKeys++;
+    setEntry(node, index, entryAt(sibling, 0));
+    for (int i = 0; i + 1 < (int)sibling->numKeys; i++) {
+      setEntry(sibling, i, entryAt(sibling, i + 1));
+    }
+    for (int i = 0; i < (int)sibling->numKeys; i++) {
+      sibling->children[i] = sibling->children[i + 1];
+    }
+    sibling->numKeys--;
+    return index;
+  }
+  if (index == (int)node->numKeys) {
+    index--;
+  }
+  merge(node, index);
+  return index;
+}
+
+// removes the largest entry under node
+static struct Entry removeMax(struct BTreeNode *node) {
+  while (!node->leaf) {
+    int i = node->numKeys;
+    if (node->children[i]->numKeys <= MIN_KEYS) {
+      i = fill(node, i);
+    }
+    node = node->children[i];
+  }
+  node->numKeys--;
+  return entryAt(node, node->numKeys);
+}
+
+// removes the smallest entry under node
+static struct Entry removeMin(struct BTreeNode *node) {
+  while (!node->leaf) {
+    if (node->children[0]->numKeys <= MIN_KEYS) {
+      fill(node, 0);
+    }
+    node = node->children[0];
+  }
+  struct Entry e = entryAt(node, 0);
+  for (int i = 0; i + 1 < (int)node->numKeys; i++) {
+    setEntry(node, i, entryAt(node, i + 1));
+  }
+  node->numKeys--;
+  return e;
+}
+
+// every node we descend into has a key to spare, so removal never backtracks
+static bool removeKey(struct BTreeNode *node, struct BTreeKey key, struct Entry *removed) {
+  while (true) {
+    bool found;
+    int i = findIndex(node, key, &found);
+    if (found && node->leaf) {
+      *removed = entryAt(node, i);
+      for (; i + 1 < (int)node->numKeys; i++) {
+        setEntry(node, i, entryAt(node, i + 1));
+      }
+      node->numKeys--;
+      return true;
+    }
+    if (found) {
+      if (node->children[i]->numKeys > MIN_KEYS) {
+        *removed = entryAt(node, i);
+        setEntry(node, i, removeMax(node->children[i]));
+        return true;
+      }
+      if (node->children[i + 1]->numKeys > MIN_KEYS) {
+        *removed = entryAt(node, i);
+        setEntry(node, i, removeMin(node->children[i + 1]));
+        return true;
       }
-      insert(node->children[i], key, data);
-      *root = node;
-    } else {
-      insert(*root, key, data);
+      merge(node, i);
+      node = node->children[i];
+      continue;
     }
+    if (node->leaf) {
+      return false;
+    }
+    if (node->children[i]->numKeys <= MIN_KEYS) {
+      i = fill(node, i);
+    }
+    node = node->children[i];
   }
 }
 
-void *bTreeSearch(struct BTreeNode *root, uint32_t key) {
-  if (root == NULL) {
+// returns the removed data, or NULL if the key wasn't there
+void *bTreeRemove(struct BTreeNode **root, struct BTreeKey key) {
+  if (*root == NULL) {
     return NULL;
   }
-  int i = 0;
-  while (i < root->numKeys && key > root->keys[i]) {
-    i++;
-  }
-  if (i < root->numKeys && key == root->keys[i]) {
-    return root->data[i];
+  struct Entry removed;
+  bool found = removeKey(*root, key, &removed);
+  if ((*root)->numKeys == 0) {
+    struct BTreeNode *old = *root;
+    *root = old->leaf ? NULL : old->children[0];
+    free(old);
   }
-  if (root->leaf) {
+  if (!found) {
     return NULL;
   }
-  return bTreeSearch(root->children[i], key);
+  free(removed.key);
+  return removed.data;
+}
+
+// builds a tree of the given height from count sorted entries
+static struct BTreeNode *build(struct BTreeKey *keys, void **data, int count, int height, uint64_t capacity) {
+  struct BTreeNode *node = newNode(height == 1);
+  if (height == 1) {
+    for (int i = 0; i < count; i++) {
+      setEntry(node, i, newEntry(keys[i], data[i]));
+    }
+    node->numKeys = count;
+    return node;
+  }
+  // capacity is what a subtree one level down holds, spread evenly over as
+  // few children as fit
+  int children = (count + 1 + capacity) / (capacity + 1);
+  int share = (count - (children - 1)) / children;
+  int extra = (count - (children - 1)) % children;
+  int pos = 0;
+  for (int i = 0; i < children; i++) {
+    int n = share + (i < extra);
+    node->children[i] = build(keys + pos, data + pos, n, height - 1,
+                              (capacity - (BTREE_ORDER - 1)) / BTREE_ORDER);
+    pos += n;
+    if (i + 1 < children) {
+      setEntry(node, i, newEntry(keys[pos], data[pos]));
+      pos++;
+    }
+  }
+  node->numKeys = children - 1;
+  return node;
+}
+
+/**
+ * Replaces the tree with count entries, which must be sorted by
+ * bTreeCompare() and unique.  Much faster than inserting one at a time and
+ * leaves every node as full as the balance allows.
+ */
+void bTreeBulkLoad(struct BTreeNode **root, struct BTreeKey *keys, void **data, int count) {
+  bTreeFree(*root);
+  *root = NULL;
+  if (count == 0) {
+    return;
+  }
+  int height = 1;
+  uint64_t capacity = BTREE_ORDER - 1;  // keys a tree of this height holds
+  while (capacity < (uint64_t)count) {
+    capacity = capacity * BTREE_ORDER + BTREE_ORDER - 1;
+    height++;
+  }
+  *root = build(keys, data, count, height, (capacity - (BTREE_ORDER - 1)) / BTREE_ORDER);
+}
+
+void bTreeFree(struct BTreeNode *root) {
+  if (root == NULL) {
+    return;
+  }
+  for (int i = 0; i < (int)root->numKeys; i++) {
+    free(root->keys[i]);
+  }
+  if (!root->leaf) {
+    for (int i = 0; i <= (int)root->numKeys; i++) {
+      bTreeFree(root->children[i]);
+    }
+  }
+  free(root);
+}
+
+void bTreeInsert(struct BTreeNode **root, uint32_t key, void *data) {
+  bTreePut(root, bTreeIntKey(key), data);
+}
+
+void *bTreeSearch(struct BTreeNode *root, uint32_t key) {
+  return bTreeGet(root, bTreeIntKey(key));
 }
@@ -4,15 +4,39 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define BTREE_ORDER 4
+// 15 four byte key prefixes fill a cache line
+#define BTREE_ORDER 16
+
+/**
+ * Keys are byte strings compared lexicographically.  The first four bytes
+ * are kept big-endian in prefix so most comparisons never touch the string,
+ * and keys of four bytes or less are never stored as strings at all.
+ * Integer keys are four byte keys, so they sort numerically.
+ */
+struct BTreeKey {
+  uint32_t prefix;
+  uint32_t len;
+  const char *str;
+};
 
 struct BTreeNode {
   uint32_t numKeys;
-  uint32_t keys[BTREE_ORDER - 1];
+  uint32_t prefix[BTREE_ORDER - 1];
+  uint32_t len[BTREE_ORDER - 1];
+  char *keys[BTREE_ORDER - 1];  // NULL if the whole key is in its prefix
   void *data[BTREE_ORDER - 1];
   struct BTreeNode *children[BTREE_ORDER];
   bool leaf;
 };
 
+extern struct BTreeKey bTreeIntKey(uint32_t key);
+extern struct BTreeKey bTreeStrKey(const char *str, uint32_t len);
+extern int bTreeCompare(struct BTreeKey a, struct BTreeKey b);
+extern void *bTreePut(struct BTreeNode **root, struct BTreeKey key, void *data);
+extern void *bTreeGet(struct BTreeNode *root, struct BTreeKey key);
+extern void *bTreeRemove(struct BTreeNode **root, struct BTreeKey key);
+extern void bTreeBulkLoad(struct BTreeNode **root, struct BTreeKey *keys, void **data, int count);
+extern void bTreeFree(struct BTreeNode *root);
+
 extern void bTreeInsert(struct BTreeNode **root, uint32_t key, void *data);
 void *bTreeSearch(struct BTreeNode *root, uint32_t key);
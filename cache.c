@@ -0,0 +1,178 @@
+/** @copyright 2025 Sean Kasun */
+#include "cache.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * A bounded LRU of formatted results, keyed by the line and the output
+ * state it was formatted with.  Entries are chained per hash bucket and
+ * kept in a list from most to least recently used.
+ */
+struct Entry {
+  struct Entry *chain;
+  struct Entry *newer;
+  struct Entry *older;
+  uint64_t hash;
+  struct Value value;
+  size_t size;
+  size_t keyLen;
+  size_t outputLen;
+  char data[];  // key followed by the output
+};
+
+struct Cache {
+  struct Entry **buckets;
+  size_t numBuckets;
+  size_t count;
+  size_t bytes;
+  size_t maxBytes;
+  struct Entry *newest;
+  struct Entry *oldest;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+};
+
+static uint64_t fnv1a(const char *s, size_t len) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ (uint8_t)s[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+struct Cache *cacheCreate(size_t maxBytes) {
+  struct Cache *cache = calloc(1, sizeof(struct Cache));
+  cache->numBuckets = 256;
+  cache->buckets = calloc(cache->numBuckets, sizeof(struct Entry *));
+  cache->maxBytes = maxBytes;
+  return cache;
+}
+
+static void detach(struct Cache *cache, struct Entry *e) {
+  if (e->newer) {
+    e->newer->older = e->older;
+  } else {
+    cache->newest = e->older;
+  }
+  if (e->older) {
+    e->older->newer = e->newer;
+  } else {
+    cache->oldest = e->newer;
+  }
+}
+
+static void pushNewest(struct Cache *cache, struct Entry *e) {
+  e->newer = NULL;
+  e->older = cache->newest;
+  if (cache->newest) {
+    cache->newest->newer = e;
+  } else {
+    cache->oldest = e;
+  }
+  cache->newest = e;
+}
+
+static void evictOldest(struct Cache *cache) {
+  struct Entry *e = cache->oldest;
+  detach(cache, e);
+  struct Entry **p = &cache->buckets[e->hash & (cache->numBuckets - 1)];
+  while (*p != e) {
+    p = &(*p)->chain;
+  }
+  *p = e->chain;
+  cache->count--;
+  cache->bytes -= e->size;
+  cache->evictions++;
+  valueClear(&e->value);
+  free(e);
+}
+
+static void grow(struct Cache *cache) {
+  size_t num = cache->numBuckets * 2;
+  struct Entry **buckets = calloc(num, sizeof(struct Entry *));
+  for (size_t i = 0; i < cache->numBuckets; i++) {
+    struct Entry *e = cache->buckets[i];
+    while (e) {
+      struct Entry *next = e->chain;
+      e->chain = buckets[e->hash & (num - 1)];
+      buckets[e->hash & (num - 1)] = e;
+      e = next;
+    }
+  }
+  free(cache->buckets);
+  cache->buckets = buckets;
+  cache->numBuckets = num;
+}
+
+void cacheFree(struct Cache *cache) {
+  while (cache->oldest) {
+    evictOldest(cache);
+  }
+  free(cache->buckets);
+  free(cache);
+}
+
+// on a hit v is set to a copy of the cached value
+bool cacheFind(struct Cache *cache, const char *key, size_t keyLen, struct Value *v,
+               const char **output, size_t *outputLen) {
+  uint64_t hash = fnv1a(key, keyLen);
+  for (struct Entry *e = cache->buckets[hash & (cache->numBuckets - 1)]; e; e = e->chain) {
+    if (e->hash == hash && e->keyLen == keyLen && !memcmp(e->data, key, keyLen)) {
+      detach(cache, e);
+      pushNewest(cache, e);
+      valueSet(v, e->value);
+      *output = e->data + keyLen;
+      *outputLen = e->outputLen;
+      cache->hits++;
+      return true;
+    }
+  }
+  cache->misses++;
+  return false;
+}
+
+static size_t valueSize(struct Value v) {
+  if (v.isF) {
+    return (mpf_get_prec(v.f) / GMP_NUMB_BITS + 2) * sizeof(mp_limb_t);
+  }
+  return mpz_size(v.z) * sizeof(mp_limb_t);
+}
+
+void cacheInsert(struct Cache *cache, const char *key, size_t keyLen, struct Value v,
+                 const char *output, size_t outputLen) {
+  size_t size = sizeof(struct Entry) + keyLen + outputLen + valueSize(v);
+  if (size > cache->maxBytes) {
+    return;
+  }
+  while (cache->bytes + size > cache->maxBytes) {
+    evictOldest(cache);
+  }
+  struct Entry *e = malloc(sizeof(struct Entry) + keyLen + outputLen);
+  e->hash = fnv1a(key, keyLen);
+  e->size = size;
+  e->keyLen = keyLen;
+  e->outputLen = outputLen;
+  memcpy(e->data, key, keyLen);
+  memcpy(e->data + keyLen, output, outputLen);
+  valueSet(&e->value, v);
+  if (cache->count >= cache->numBuckets) {
+    grow(cache);
+  }
+  struct Entry **bucket = &cache->buckets[e->hash & (cache->numBuckets - 1)];
+  e->chain = *bucket;
+  *bucket = e;
+  pushNewest(cache, e);
+  cache->count++;
+  cache->bytes += size;
+}
+
+void cacheStats(struct Cache *cache, FILE *out) {
+  uint64_t lookups = cache->hits + cache->misses;
+  fprintf(out, "cache: %llu hits, %llu misses (%.1f%% hit rate), %llu evictions, "
+          "%zu entries using %zu of %zu bytes\n",
+          (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+          lookups ? 100.0 * cache->hits / lookups : 0.0,
+          (unsigned long long)cache->evictions, cache->count, cache->bytes, cache->maxBytes);
+}
@@ -0,0 +1,17 @@
+/** @copyright 2025 Sean Kasun */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "calculator.h"
+
+struct Cache;
+
+extern struct Cache *cacheCreate(size_t maxBytes);
+extern void cacheFree(struct Cache *cache);
+extern bool cacheFind(struct Cache *cache, const char *key, size_t keyLen, struct Value *v,
+                      const char **output, size_t *outputLen);
+extern void cacheInsert(struct Cache *cache, const char *key, size_t keyLen, struct Value v,
+                        const char *output, size_t outputLen);
+extern void cacheStats(struct Cache *cache, FILE *out);
@@ -1,44 +1,146 @@
 /** @copyright 2025 Sean Kasun */
 #include "calculator.h"
+#include "bits.h"
 #include "btree.h"
 #include "mpextras.h"
+#include "modular.h"
+#include "store.h"
+#include "utf8.h"
 #include <ctype.h>
 #include <float.h>
 #include <gmp.h>
+#include <limits.h>
 #include <math.h>
+#include <poll.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 enum {
   OR, XOR, AND, SHL, SHR, ADD, SUB, MUL, DIV, MOD, NEG, POS, NOT, POW, SQRT, COS, SIN, TAN, FLOOR, CEIL, ROUND,
+  POPCNT, CLZ, CTZ, BSWAP, BITREV, BITFIELD, PDEP, PEXT,
 };
 enum {
   Left, Right, Unary,
 };
 
 struct Op {
+  const char *token;
+  int len;
   int prec;
   int assoc;
   int output;
 };
 
-struct List {
-  const char *token;
-  int len;
-  struct List *next;
+#define OP(token, prec, assoc, output) {token, sizeof(token) - 1, prec, assoc, output}
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+// both sorted by token, the way bTreeCompare() orders them
+static const struct Op unaryOps[] = {
+  OP("+", 5, Unary, POS),
+  OP("-", 5, Unary, NEG),
+  OP("bitfield", 8, Unary, BITFIELD),
+  OP("bitrev", 8, Unary, BITREV),
+  OP("bswap", 8, Unary, BSWAP),
+  OP("ceil", 8, Unary, CEIL),
+  OP("clz", 8, Unary, CLZ),
+  OP("cos", 8, Unary, COS),
+  OP("ctz", 8, Unary, CTZ),
+  OP("floor", 8, Unary, FLOOR),
+  OP("popcnt", 8, Unary, POPCNT),
+  OP("round", 8, Unary, ROUND),
+  OP("sin", 8, Unary, SIN),
+  OP("sqrt", 8, Unary, SQRT),
+  OP("tan", 8, Unary, TAN),
+  OP("~", 6, Unary, NOT),
+};
+
+static const struct Op binaryOps[] = {
+  OP("%", 5, Left, MOD),
+  OP("&", 2, Left, AND),
+  OP("*", 5, Left, MUL),
+  OP("**", 7, Right, POW),
+  OP("+", 4, Left, ADD),
+  OP("-", 4, Left, SUB),
+  OP("/", 5, Left, DIV),
+  OP("<<", 3, Left, SHL),
+  OP(">>", 3, Left, SHR),
+  OP("^", 1, Left, XOR),
+  OP("pdep", 2, Left, PDEP),
+  OP("pext", 2, Left, PEXT),
+  OP("|", 0, Left, OR),
+};
+
+// everything else that ends a number
+static const char punctuation[] = "()'\",";
+
+// the first character of every terminator, for skipping to the next one
+static char starts[COUNT(unaryOps) + COUNT(binaryOps) + sizeof(punctuation)];
+
+/**
+ * A value with many holders: $ while parsing, the result history and named
+ * registers.  Leaves point at it rather than copying it.
+ */
+struct Shared {
+  int refs;
+  struct Value value;
+};
+
+// the $, results and registers a line read, and what each of them was
+struct Bound {
+  int count;
+  char **names;
+  struct Shared **shared;
+};
+
+/**
+ * A result the double fast path vouched for holds a double's worth of bits,
+ * which is all printing needs.  Its line is kept with what it read, so once
+ * it's read as $, an older result or a register, it's worked out the long
+ * way, just as if the fast path had never been tried.
+ */
+struct Pending {
+  int refs;
+  char *expression;  // NULL once value is worked out
+  struct Bound bound;
+  int digits, base;
+  struct Value value;
 };
 
+/**
+ * Identical subtrees are shared, so this is really a DAG.  refs counts the
+ * parents holding each node.  Once a branch is evaluated it turns into a
+ * leaf holding its result, so other parents don't evaluate it again.
+ */
 struct Tree {
-  struct Op *op;
+  const struct Op *op;
   struct Tree *left;
   struct Tree *right;
-  struct Value leaf;
+  struct Value value;
+  int column;  // leaf is $column, its value comes from each row
+  struct Shared *shared;  // leaf value lives here instead
+  int refs;
+  int height;  // longest path down to a leaf
+  struct StoreKey key;  // names the value for the store, all zero if nothing can
+  struct Tree *chain;  // next node with the same hash while parsing
 };
 
 struct Reader {
   const char *p;
   const char *end;
+  bool columns;  // $1, $2... refer to columns
+  struct BTreeNode *interned;
+  int depth;  // of parse() calls
+  bool prevColumn;  // $ is column 1, so the line can be evaluated for many values of it
+  struct Bound *bound;  // names are found here first, and what they find is added
+};
+
+struct Expression {
+  struct Tree *tree;
+  int columns;
+  bool batchable;
 };
 
 struct Token {
@@ -47,54 +149,823 @@ struct Token {
 };
 
 static struct BTreeNode *unaries = NULL, *binaries = NULL;
-static struct List *terminators = NULL;
-static char *errorMsg;
+static _Thread_local char *errorMsg;  // so printing on another thread reports its own
+static struct ModContext *modulus = NULL;
+static int width = 0;  // fixed width integer mode when nonzero
+static bool widthSigned = false;
+static struct BTreeNode *history = NULL;  // result number to Shared
+static uint32_t results = 0;  // how many results were ever remembered
+static struct BTreeNode *registers = NULL;  // name to Shared
+static unsigned generation = 0;  // bumped whenever a register changes
+static atomic_int interrupted = 0;  // lock free, so a signal handler can set it too
+static double timeLimit = 0;  // seconds per calculation, 0 for no limit
+static struct timespec deadline;
+static int stopInput = -1;  // a descriptor whose waiting input stops calculations, -1 for none
+static _Thread_local bool stopped = false;  // printing checks it too, maybe on another thread
+static int digits = 0;  // significant digits to get right, 0 for the default precision
+static int digitsBase = 10;
+static long lostBits;  // accuracy the current evaluation may have lost
+static long roundings;  // float operations, each of which may be an ulp off
+static bool previewing = false;  // no registers change, and integers stay small
+static bool optimize = true;  // shortcuts that give the same results, only sooner
+static struct Store *store = NULL;  // slow results kept across runs
+static struct StoreKey modKey;  // of the modulus, all zero without one
+
+#define HISTORY_SIZE 1000
+#define MAX_DIGITS 1000000
+#define GUARD_BITS 32
+#define MAX_PREC (1 << 14)  // results that cancel to nothing here are taken as 0
+#define ZERO_MAGNITUDE (LONG_MIN / 4)
+#define PREVIEW_BITS (1 << 18)
+#define MAX_BITS (1UL << 32)  // integers past this take too long to print anyway
+#define MAX_EXPONENT (LONG_MAX / 4)  // float magnitudes in bits have to fit a long
+#define STORE_SECONDS 0.01  // ops that take longer are worth keeping across runs
+#define PI_KEY 1000  // tags pi among the op outputs in store keys
+#define MAX_DEPTH 2000  // parsing and evaluating recurse this deep, about 1MB of stack
+#define INPUT_CHECKS 64  // polling for input costs a system call, so only every this many checks
+#define FAST_BITS (DBL_MANT_DIG - 3)  // bounds a few ulps apart can still settle digits this fine
+
+typedef unsigned __int128 u128;
+typedef __int128 i128;
 
 static void init();
-static struct Tree *parse(int prec, struct Reader *reader, struct Value prev);
-static struct Tree *primary(struct Reader *reader, struct Value prev);
+static struct Tree *parse(int prec, struct Reader *reader, struct Shared *prev);
+static struct Tree *primary(struct Reader *reader, struct Shared *prev);
 static struct Token next(struct Reader *reader);
 static struct Value eval(struct Tree *tree);
+static struct Value apply(struct Tree *tree);
+static u128 evalFixed(struct Tree *tree);
+static void fixedToValue(struct Value *v, u128 x);
 static void consume(struct Reader *reader, struct Token token);
-static int findIndexOf(const char *needle, const char *haystack);
 static bool expect(struct Reader *reader, char c);
-static struct Tree *branch(struct Op *op, struct Tree *left, struct Tree *right);
-static struct Tree *leaf(struct Reader *reader, struct Value prev);
+static struct Tree *branch(struct Reader *reader, const struct Op *op, struct Tree *left, struct Tree *right);
+static struct Tree *leaf(struct Reader *reader, struct Shared *prev);
 static struct Tree *parseChar(struct Reader *reader);
+static struct Tree *parseString(struct Reader *reader);
+static struct Tree *parseBitfield(struct Reader *reader, struct Shared *prev, const struct Op *op);
 static void freeTree(struct Tree *t);
+static struct Tree *bindColumns(struct Tree *t, struct Value *columns);
+static struct Tree *parseAll(struct Reader *reader, struct Shared *prev);
+static int assignment(const char **expression, const char **name);
+static struct Shared *share(struct Value v);
+static void release(struct Shared *s);
+static struct Value take(struct Shared *s);
+static void startClock();
+static struct Value run(const char *expression, struct Value prev);
+static struct Value evalOnce(const char *expression, struct Shared *last, struct Bound *bound,
+                             bool *certified);
+static struct Value evalDigits(const char *expression, struct Shared *last, struct Bound *bound);
+static bool evalFast(struct Tree *tree, struct Value *v);
+static struct Pending *pend(const char *expression, struct Bound bound);
+static void dropPending(struct Pending *p);
+static void freeBound(struct Bound *bound);
+static bool settle(struct Value *v);
 
+/**
+ * Evaluates the expression, consuming prev.  If the calculation is stopped
+ * by calcInterrupt() or the time limit, prev is handed back unchanged.
+ */
 struct Value calculate(const char *expression, struct Value prev) {
-  if (!terminators) {
+  previewing = false;
+  return run(expression, prev);
+}
+
+/**
+ * Like calculate(), but assigns nothing, and integers that would grow past
+ * PREVIEW_BITS are an error, so it's cheap enough for every keystroke.
+ */
+struct Value calcPreview(const char *expression, struct Value prev) {
+  previewing = true;
+  struct Value v = run(expression, prev);
+  previewing = false;
+  return v;
+}
+
+static struct Value run(const char *expression, struct Value prev) {
+  if (!binaries) {
     init();
   }
   errorMsg = NULL;
+  startClock();
+  const char *name;
+  int nameLen = assignment(&expression, &name);
+  struct Shared *last = share(prev);
+  struct Value v;
+  if (nameLen < 0) {
+    valueInitZ(&v);
+  } else if (digits && !width) {
+    v = evalDigits(expression, last, NULL);
+  } else {
+    v = evalOnce(expression, last, NULL, NULL);
+  }
+  if (stopped) {
+    valueClear(&v);
+    return take(last);
+  }
+  release(last);
+  if (nameLen > 0 && !errorMsg && !previewing) {
+    struct Value copy;
+    calcCopy(&copy, v);
+    struct Shared *s = share(copy);
+    struct Shared *old = bTreePut(&registers, bTreeStrKey(name, nameLen), s);
+    if (old) {
+      release(old);
+    }
+    generation++;
+  }
+  return v;
+}
+
+/**
+ * Parses and evaluates the expression.  If certified isn't NULL the double
+ * fast path is tried first, and it's set when that result was good enough.
+ * If bound isn't NULL, the names the line reads are kept there.
+ */
+static struct Value evalOnce(const char *expression, struct Shared *last, struct Bound *bound,
+                             bool *certified) {
   struct Reader reader = {
-    expression,
-    expression + strlen(expression),
+    .p = expression,
+    .end = expression + strlen(expression),
+    .bound = bound,
   };
-  struct Tree *tree = parse(0, &reader, prev);
-  mpf_clear(prev.f);
-  mpz_clear(prev.z);
+  struct Tree *tree = parseAll(&reader, last);
   struct Value v;
-  mpf_init(v.f);
-  mpz_init(v.z);
   if (tree == NULL) {
-    return v;
-  }
-  if (reader.p != reader.end) {
+    valueInitZ(&v);
+  } else if (width) {
+    valueInitZ(&v);
+    fixedToValue(&v, evalFixed(tree));
     freeTree(tree);
-    errorMsg = "Expected operator";
-    return v;
+  } else if (certified && evalFast(tree, &v)) {
+    *certified = true;
+    freeTree(tree);
+  } else {
+    v = eval(tree);
+  }
+  return v;
+}
+
+static long bitLength(unsigned long x) {
+  return x ? 64 - __builtin_clzl(x) : 0;
+}
+
+// about log2 |v|, and far below that of anything else for zero
+static long magnitude(struct Value v) {
+  if (!v.isF) {
+    return mpz_sgn(v.z) ? (long)mpz_sizeinbase(v.z, 2) : ZERO_MAGNITUDE;
+  }
+  if (!mpf_sgn(v.f)) {
+    return ZERO_MAGNITUDE;
+  }
+  long e;
+  mpf_get_d_2exp(&e, v.f);
+  return e;
+}
+
+// whether everything within 2^-goodBits of v, relatively, rounds to the same digits
+static bool decided(struct Value v, long goodBits) {
+  if (goodBits < 2) {
+    return false;
+  }
+  mp_bitcnt_t prec = mpf_get_prec(v.f) + GMP_NUMB_BITS;
+  mpf_t err, lo, hi;
+  mpf_init2(err, prec);
+  mpf_init2(lo, prec);
+  mpf_init2(hi, prec);
+  mpf_abs(err, v.f);
+  mpf_div_2exp(err, err, goodBits);
+  mpf_sub(lo, v.f, err);
+  mpf_add(hi, v.f, err);
+  mp_exp_t loExp, hiExp;
+  char *a = mpf_get_str_rounded(&loExp, digitsBase, digits, lo);
+  char *b = mpf_get_str_rounded(&hiExp, digitsBase, digits, hi);
+  bool same = loExp == hiExp && !strcmp(a, b);
+  free(a);
+  free(b);
+  mpf_clear(err);
+  mpf_clear(lo);
+  mpf_clear(hi);
+  return same;
+}
+
+/**
+ * Ziv's strategy.  Evaluates at just enough precision for the digits plus
+ * a guard, and only if the error estimated from cancellation and function
+ * conditioning could change how the result rounds, again with those bits
+ * added on.  When a double can hold the digits, the first try also bounds
+ * the result in doubles, which usually settles it without any of that, and
+ * then the result is pending the rest.  bound is set when that's being
+ * worked out, and holds what the line read the first time.
+ */
+static struct Value evalDigits(const char *expression, struct Shared *last, struct Bound *bound) {
+  mp_bitcnt_t saved = mpf_get_default_prec();
+  long wanted = ceil(digits * log2(digitsBase));
+  long maxPrec = wanted * 4 > MAX_PREC ? wanted * 4 : MAX_PREC;
+  long prec = wanted + GUARD_BITS;
+  struct Value v;
+  // only worth trying if doubles have bits to spare beyond the digits
+  bool fast = optimize && wanted <= FAST_BITS && !modulus && !bound;
+  struct Bound read = {0};
+  bool certified = false;
+  while (true) {
+    mpf_set_default_prec(prec);
+    lostBits = 0;
+    roundings = 0;
+    v = evalOnce(expression, last, fast ? &read : bound, fast ? &certified : NULL);
+    fast = false;
+    if (certified || errorMsg || stopped || !v.isF) {
+      break;
+    }
+    long errorBits = lostBits + bitLength(2 * roundings + 1);
+    if (decided(v, prec - errorBits)) {
+      break;
+    }
+    if (prec >= maxPrec) {
+      if (errorBits >= prec && magnitude(v) < 0) {  // nothing left but noise
+        mpf_set_ui(v.f, 0);
+      } else {
+        errorMsg = "Too unstable to round";
+      }
+      break;
+    }
+    valueClear(&v);
+    if (prec < wanted + errorBits + GUARD_BITS) {
+      prec = wanted + errorBits + GUARD_BITS;
+    } else {  // close to a rounding boundary
+      prec += prec / 2;
+    }
+    if (prec > maxPrec) {
+      prec = maxPrec;
+    }
+  }
+  mpf_set_default_prec(saved);
+  // previews are thrown away, so only a result the caller keeps needs the rest
+  if (certified && !previewing) {
+    v.pending = pend(expression, read);
+  } else {
+    freeBound(&read);
+  }
+  return v;
+}
+
+/**
+ * Bounds on a value in doubles, so every operation widens them by the
+ * rounding it could have done.  Integers are carried exactly while they fit,
+ * since they divide and wrap differently.
+ */
+struct Interval {
+  double lo, hi;
+  bool isZ;
+  int64_t z;
+};
+
+static double down(double x) {
+  return nextafter(x, -INFINITY);
+}
+
+static double up(double x) {
+  return nextafter(x, INFINITY);
+}
+
+/**
+ * Bounds on the exact a op b, for the ops IEEE rounds correctly.  That's
+ * within half an ulp of the rounded result, and the error an error-free
+ * transformation recovers says on which side, so each bound is either the
+ * result or its neighbour, and both are the result when it's exact.
+ */
+static void rounded(int output, double a, double b, double *lo, double *hi) {
+  double x, err, t;
+  switch (output) {
+    case ADD:  // TwoSum, exact even for subnormals
+      x = a + b;
+      t = x - a;
+      err = (a - (x - t)) + (b - t);
+      break;
+    case MUL:
+      x = a * b;
+      err = fma(a, b, -x);
+      break;
+    case DIV:  // a - x * b, the remainder, has the sign of the error when b is positive
+      x = a / b;
+      err = fma(-x, b, a);
+      err = b < 0 ? -err : err;
+      break;
+    default:  // SQRT
+      x = sqrt(a);
+      err = fma(-x, x, a);
+      break;
+  }
+  // fma() can't give the whole error of results near underflow
+  bool tiny = output != ADD && a != 0 && (output != MUL || b != 0) &&
+      (fabs(x) < 0x1p-900 || fabs(a) < 0x1p-900);
+  if (tiny || !isfinite(err)) {
+    *lo = down(x);
+    *hi = up(x);
+  } else {
+    *lo = err < 0 ? down(x) : x;
+    *hi = err > 0 ? up(x) : x;
+  }
+}
+
+static void toInterval(struct Interval *a) {
+  if (a->isZ) {
+    a->lo = a->hi = a->z;
+    // past 2^53 it may have been rounded, and 2^63 itself is out of range
+    if (a->lo >= 0x1p63 || (int64_t)a->lo > a->z) {
+      a->lo = down(a->lo);
+    } else if ((int64_t)a->hi < a->z) {
+      a->hi = up(a->hi);
+    }
+    a->isZ = false;
+  }
+}
+
+static bool boundLeaf(struct Value v, struct Interval *out) {
+  if (!v.isF) {
+    out->isZ = mpz_fits_slong_p(v.z);
+    out->z = mpz_get_si(v.z);
+    return out->isZ;
+  }
+  long e;
+  mpf_get_d_2exp(&e, v.f);
+  if (mpf_sgn(v.f) && labs(e) > DBL_MAX_EXP - DBL_MANT_DIG) {  // too close to the double range
+    return false;
+  }
+  // mpf_get_d() truncates, so anything it leaves off is further from zero
+  double d = mpf_get_d(v.f);
+  out->isZ = false;
+  out->lo = out->hi = d;
+  int c = mpf_cmp_d(v.f, d);
+  if (c > 0) {
+    out->hi = up(d);
+  } else if (c < 0) {
+    out->lo = down(d);
+  }
+  return true;
+}
+
+// only four corners to try, both operands are monotonic in each
+static void corners(struct Interval *out, struct Interval l, struct Interval r, int output) {
+  out->lo = INFINITY;
+  out->hi = -INFINITY;
+  for (int i = 0; i < 4; i++) {
+    double a = i & 1 ? l.hi : l.lo, b = i & 2 ? r.hi : r.lo, lo, hi;
+    if (output == POW) {  // libm's pow() is only within an ulp
+      lo = hi = pow(a, b);
+      lo = down(down(lo));
+      hi = up(up(hi));
+    } else {
+      rounded(output, a, b, &lo, &hi);
+    }
+    out->lo = fmin(out->lo, lo);
+    out->hi = fmax(out->hi, hi);
+  }
+}
+
+static bool evalIntegers(int output, struct Interval *l, struct Interval r) {
+  switch (output) {
+    case ADD:
+      return !__builtin_add_overflow(l->z, r.z, &l->z);
+    case SUB:
+      return !__builtin_sub_overflow(l->z, r.z, &l->z);
+    case MUL:
+      return !__builtin_mul_overflow(l->z, r.z, &l->z);
+    case DIV:  // floors, like mpz_div
+      if (r.z == 0 || (r.z == -1 && l->z == INT64_MIN)) {
+        return false;
+      }
+      l->z = l->z / r.z - ((l->z % r.z) && ((l->z ^ r.z) < 0));
+      return true;
+    case MOD:  // truncates, like mpz_tdiv_r
+      if (r.z == 0 || r.z == -1) {
+        l->z = 0;
+        return r.z != 0;
+      }
+      l->z %= r.z;
+      return true;
+    case NEG:
+      if (l->z == INT64_MIN) {
+        return false;
+      }
+      l->z = -l->z;
+      return true;
+    case POS:
+    case FLOOR:
+    case CEIL:
+    case ROUND:
+      return true;
+  }
+  return false;
+}
+
+/**
+ * Evaluates the tree in interval arithmetic on doubles, leaving it intact.
+ * False if it needs anything beyond that, or the bounds get out of hand.
+ * libm's sin, cos, tan and pow are trusted to within an ulp, as glibc's are.
+ */
+static bool evalInterval(struct Tree *tree, struct Interval *out) {
+  if (tree->op == NULL) {
+    return boundLeaf(tree->shared ? tree->shared->value : tree->value, out);
+  }
+  struct Interval l, r = {0, 0, true, 0};
+  if (!evalInterval(tree->left, &l) || (tree->right && !evalInterval(tree->right, &r))) {
+    return false;
+  }
+  int output = tree->op->output;
+  bool floats = output == POW || output == SQRT || output == COS || output == SIN || output == TAN;
+  if (l.isZ && r.isZ && !floats) {
+    *out = l;
+    return evalIntegers(output, out, r);
+  }
+  toInterval(&l);
+  toInterval(&r);
+  *out = l;
+  double m, radius, s, slope, ignored;
+  switch (output) {
+    case ADD:
+      rounded(ADD, l.lo, r.lo, &out->lo, &ignored);
+      rounded(ADD, l.hi, r.hi, &ignored, &out->hi);
+      break;
+    case SUB:
+      rounded(ADD, l.lo, -r.hi, &out->lo, &ignored);
+      rounded(ADD, l.hi, -r.lo, &ignored, &out->hi);
+      break;
+    case DIV:
+      if (r.lo <= 0 && r.hi >= 0) {
+        return false;
+      }
+      // fall through
+    case MUL:
+      corners(out, l, r, output);
+      break;
+    case POW:
+      if (l.lo <= 0) {  // negative bases are only real for integer powers
+        return false;
+      }
+      corners(out, l, r, output);
+      break;
+    case NEG:
+      out->lo = -l.hi;
+      out->hi = -l.lo;
+      break;
+    case POS:
+      break;
+    case SQRT:
+      if (l.lo < 0) {
+        return false;
+      }
+      rounded(SQRT, l.lo, 0, &out->lo, &ignored);
+      rounded(SQRT, l.hi, 0, &ignored, &out->hi);
+      break;
+    case SIN:
+    case COS:  // the slope is within the radius of what it is at m, and never over 1
+      m = l.lo / 2 + l.hi / 2;
+      rounded(ADD, m, -l.lo, &ignored, &radius);
+      rounded(ADD, l.hi, -m, &ignored, &s);
+      radius = fmax(radius, s);
+      rounded(ADD, up(fabs(output == SIN ? cos(m) : sin(m))), radius, &ignored, &slope);
+      rounded(MUL, radius, fmin(slope, 1), &ignored, &radius);
+      s = output == SIN ? sin(m) : cos(m);
+      rounded(ADD, down(s), -radius, &out->lo, &ignored);
+      rounded(ADD, up(s), radius, &ignored, &out->hi);
+      out->lo = fmax(out->lo, -1);
+      out->hi = fmin(out->hi, 1);
+      break;
+    case TAN:  // increasing between poles, and cos changes sign at each one
+      if (l.hi - l.lo > 1 || !(cos(l.lo) * cos(l.hi) > 1e-9)) {
+        return false;
+      }
+      out->lo = down(down(tan(l.lo)));
+      out->hi = up(up(tan(l.hi)));
+      break;
+    case FLOOR:
+    case CEIL:
+      m = output == FLOOR ? floor(l.lo) : ceil(l.lo);
+      if (m != (output == FLOOR ? floor(l.hi) : ceil(l.hi)) || fabs(m) > 0x1p53) {
+        return false;
+      }
+      out->isZ = true;
+      out->z = m;
+      return true;
+    default:
+      return false;
   }
-  prev = eval(tree);
-  v.isF = prev.isF;
-  if (prev.isF) {
-    mpf_set(v.f, prev.f);
+  // the long way takes what may have cancelled to nothing for noise, and so gives up on it
+  bool cancels = output == ADD || output == SUB || output == SIN || output == COS ||
+      output == TAN;
+  if (cancels && out->lo <= 0 && out->hi >= 0 && (l.lo || l.hi || r.lo || r.hi)) {
+    return false;
+  }
+  return isfinite(out->lo) && isfinite(out->hi) && out->lo <= out->hi;
+}
+
+// whether everything from lo to hi rounds to the same digits
+static bool settled(double lo, double hi) {
+  if (lo <= 0 && hi >= 0) {
+    return lo == hi;  // only an exact zero
+  }
+  static const double tens[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+  // scaled so the digits are the integer part, they're its nearest integer
+  double a = fmin(fabs(lo), fabs(hi)), b = fmax(fabs(lo), fabs(hi));
+  double first = pow(digitsBase, digits - 1);
+  bool scaled = first * digitsBase <= 0x1p52;  // where halves are still exact
+  if (digitsBase == 10) {
+    int k = digits - 1 - (int)floor(log10(a));
+    scaled &= k >= -22 && k <= 22;  // powers of ten past that aren't exact
+    if (scaled) {
+      double ignored;
+      rounded(k < 0 ? DIV : MUL, a, k < 0 ? tens[-k] : tens[k], &a, &ignored);
+      rounded(k < 0 ? DIV : MUL, b, k < 0 ? tens[-k] : tens[k], &ignored, &b);
+    }
+  } else {  // a power of two, which scales exactly
+    int bits = __builtin_ctz(digitsBase), e;
+    frexp(a, &e);
+    int top = e > 0 ? (e - 1) / bits : -((bits - e) / bits);  // digits above the point, less one
+    a = ldexp(a, (digits - 1 - top) * bits);
+    b = ldexp(b, (digits - 1 - top) * bits);
+  }
+  // and in one decade, with no tie between them
+  if (scaled && a >= first && b < first * digitsBase - 0.5) {
+    return floor(a + 0.5) == floor(b + 0.5) && a + 0.5 != floor(a + 0.5);
+  }
+  if (digitsBase == 10) {  // printf rounds exactly
+    char x[DBL_DECIMAL_DIG + 16], y[DBL_DECIMAL_DIG + 16];
+    snprintf(x, sizeof(x), "%.*e", digits - 1, lo);
+    snprintf(y, sizeof(y), "%.*e", digits - 1, hi);
+    return !strcmp(x, y);
+  }
+  mpf_t f;
+  mpf_init2(f, DBL_MANT_DIG);
+  mp_exp_t loExp, hiExp;
+  mpf_set_d(f, lo);
+  char *x = mpf_get_str_rounded(&loExp, digitsBase, digits, f);
+  mpf_set_d(f, hi);
+  char *y = mpf_get_str_rounded(&hiExp, digitsBase, digits, f);
+  bool same = loExp == hiExp && !strcmp(x, y);
+  free(x);
+  free(y);
+  mpf_clear(f);
+  return same;
+}
+
+/**
+ * Tries the tree in doubles, which is enough for most results of up to
+ * about 15 digits.  False if the bounds can't vouch for every digit, and
+ * then the caller goes the long way.  The tree is left intact.
+ */
+static bool evalFast(struct Tree *tree, struct Value *v) {
+  struct Interval i;
+  if (!evalInterval(tree, &i) || i.isZ || !settled(i.lo, i.hi)) {
+    return false;
+  }
+  valueInitF(v);
+  mpf_set_d(v->f, i.lo + (i.hi - i.lo) / 2);
+  return true;
+}
+
+static void freeBound(struct Bound *bound) {
+  for (int i = 0; i < bound->count; i++) {
+    free(bound->names[i]);
+    release(bound->shared[i]);
+  }
+  free(bound->names);
+  free(bound->shared);
+  *bound = (struct Bound){0};
+}
+
+static struct Pending *pend(const char *expression, struct Bound bound) {
+  struct Pending *p = malloc(sizeof(struct Pending));
+  p->refs = 1;
+  p->expression = strdup(expression);
+  p->bound = bound;
+  p->digits = digits;
+  p->base = digitsBase;
+  return p;
+}
+
+static void dropPending(struct Pending *p) {
+  if (--p->refs > 0) {
+    return;
+  }
+  if (p->expression) {
+    free(p->expression);
+    freeBound(&p->bound);
+  } else {
+    valueClear(&p->value);
+  }
+  free(p);
+}
+
+/**
+ * Reads the line again and works it out the long way, in the modes it was
+ * first read in, whatever they are now, and without touching the state of
+ * the evaluation that needs it.  False if that failed or was stopped, with
+ * errorMsg saying why, and then it's tried again next time.
+ */
+static bool workOut(struct Pending *p) {
+  if (!p->expression) {
+    return true;
+  }
+  struct ModContext *savedModulus = modulus;
+  struct StoreKey savedModKey = modKey;
+  int savedWidth = width, savedDigits = digits, savedBase = digitsBase;
+  bool savedPreviewing = previewing;
+  long savedLost = lostBits, savedRoundings = roundings;
+  char *savedError = errorMsg;
+  modulus = NULL;
+  modKey = (struct StoreKey){0, 0};
+  width = 0;
+  digits = p->digits;
+  digitsBase = p->base;
+  previewing = false;
+  errorMsg = NULL;
+  struct Value v = evalDigits(p->expression, NULL, &p->bound);
+  bool done = !errorMsg && !stopped;
+  modulus = savedModulus;
+  modKey = savedModKey;
+  width = savedWidth;
+  digits = savedDigits;
+  digitsBase = savedBase;
+  previewing = savedPreviewing;
+  lostBits = savedLost;
+  roundings = savedRoundings;
+  if (!done) {
+    valueClear(&v);
+    return false;
+  }
+  errorMsg = savedError;
+  free(p->expression);
+  p->expression = NULL;
+  freeBound(&p->bound);
+  p->value = v;
+  return true;
+}
+
+// before v is read, it gets all of its value, false if working it out failed or was stopped
+static bool settle(struct Value *v) {
+  if (!v->pending) {
+    return true;
+  }
+  if (!workOut(v->pending)) {
+    return false;
+  }
+  struct Value all;
+  valueSet(&all, v->pending->value);
+  valueClear(v);
+  *v = all;
+  return true;
+}
+
+// whether v is only a double's worth of a result, which prints the same
+bool calcPartial(struct Value v) {
+  return v.pending != NULL;
+}
+
+// v gets all of its value, as one that leaves zx or is kept outside it needs
+void calcSettle(struct Value *v) {
+  char *savedError = errorMsg;
+  settle(v);
+  errorMsg = savedError;
+}
+
+/**
+ * Like valueSet(), but the copy can still be worked out in full.  Only for
+ * copies kept on the calculator's thread, as printing ones needn't be.
+ */
+void calcCopy(struct Value *v, struct Value src) {
+  valueSet(v, src);
+  v->pending = src.pending;
+  if (v->pending) {
+    v->pending->refs++;
+  }
+}
+
+/**
+ * Adds the accuracy an op may have lost to lostBits.  el and er are the
+ * magnitudes of its operands, result is what it left in the left one.
+ */
+static void account(int output, long el, long er, struct Value result) {
+  roundings++;
+  long e = magnitude(result);
+  long lost = 0;
+  switch (output) {
+    case ADD:
+    case SUB:
+    case MOD:  // cancellation
+      lost = (el > er ? el : er) - e;
+      break;
+    case COS:
+    case SIN:
+      lost = el - e;
+      break;
+    case TAN:
+      lost = el + labs(e);
+      break;
+    case POW:  // as sensitive as y * log x
+      if (el != ZERO_MAGNITUDE) {
+        lost = er + bitLength(labs(el));
+      }
+      break;
+  }
+  long prec = mpf_get_default_prec();
+  if (lost > prec) {
+    lost = prec;
+  }
+  if (lost > 0) {
+    lostBits += lost;
+  }
+}
+
+void valueInitZ(struct Value *v) {
+  v->isF = false;
+  mpz_init(v->z);
+  v->pending = NULL;
+}
+
+void valueInitF(struct Value *v) {
+  v->isF = true;
+  mpf_init(v->f);
+  v->pending = NULL;
+}
+
+// only what src holds now, see calcCopy()
+void valueSet(struct Value *v, struct Value src) {
+  v->isF = src.isF;
+  v->pending = NULL;
+  if (src.isF) {
+    mpf_init2(v->f, mpf_get_prec(src.f));
+    mpf_set(v->f, src.f);
+  } else {
+    mpz_init_set(v->z, src.z);
+  }
+}
+
+void valueClear(struct Value *v) {
+  if (v->isF) {
+    mpf_clear(v->f);
   } else {
-    mpz_set(v.z, prev.z);
+    mpz_clear(v->z);
+  }
+  if (v->pending) {
+    dropPending(v->pending);
+    v->pending = NULL;
+  }
+}
+
+// floats are truncated
+void valueToZ(struct Value *v) {
+  if (v->pending) {
+    dropPending(v->pending);
+    v->pending = NULL;
+  }
+  if (v->isF) {
+    mpz_t z;
+    mpz_init(z);
+    mpz_set_f(z, v->f);
+    mpf_clear(v->f);
+    v->z[0] = z[0];
+    v->isF = false;
+  }
+}
+
+void valueToF(struct Value *v) {
+  if (!v->isF) {
+    mpf_t f;
+    mpf_init(f);
+    mpf_set_z(f, v->z);
+    mpz_clear(v->z);
+    v->f[0] = f[0];
+    v->isF = true;
+  }
+}
+
+static struct Shared *share(struct Value v) {
+  struct Shared *s = malloc(sizeof(struct Shared));
+  s->refs = 1;
+  s->value = v;
+  return s;
+}
+
+static void release(struct Shared *s) {
+  if (--s->refs == 0) {
+    valueClear(&s->value);
+    free(s);
   }
+}
 
-  freeTree(tree);  // will destroy prev
+// releases s, moving its value out if nothing else holds it
+static struct Value take(struct Shared *s) {
+  struct Value v;
+  if (s->refs == 1) {
+    v = s->value;
+    free(s);
+  } else {
+    valueSet(&v, s->value);
+    s->refs--;
+  }
   return v;
 }
 
@@ -106,94 +977,140 @@ static uint32_t djb2(const char *str, int len) {
   return hash;
 }
 
-static void addTerminator(const char *token) {
-  struct List *terminator = malloc(sizeof(struct List));
-  terminator->token = token;
-  terminator->len = strlen(token);
-  terminator->next = terminators;
-  terminators = terminator;
+// the tables are static, only the trees that index them are built
+static void load(struct BTreeNode **tree, const struct Op *ops, int count) {
+  struct BTreeKey keys[count];
+  void *data[count];
+  for (int i = 0; i < count; i++) {
+    keys[i] = bTreeStrKey(ops[i].token, ops[i].len);
+    data[i] = (void *)&ops[i];
+  }
+  bTreeBulkLoad(tree, keys, data, count);
 }
 
-static void add(const char *token, int prec, int assoc, int output) {
-  struct Op *op = malloc(sizeof(struct Op));
-  op->assoc = assoc;
-  op->prec = prec;
-  op->output = output;
-  uint32_t key = djb2(token, strlen(token));
-  if (assoc == Unary) {
-    bTreeInsert(&unaries, key, op);
-  } else {
-    bTreeInsert(&binaries, key, op);
+static void addStart(char c) {
+  if (!strchr(starts, c)) {
+    starts[strlen(starts)] = c;
   }
-  addTerminator(token);
 }
 
 static void init() {
-  add("|", 0, Left, OR);
-  add("^", 1, Left, XOR);
-  add("&", 2, Left, AND);
-  add("<<", 3, Left, SHL);
-  add(">>", 3, Left, SHR);
-  add("+", 4, Left, ADD);
-  add("-", 4, Left, SUB);
-  add("*", 5, Left, MUL);
-  add("/", 5, Left, DIV);
-  add("%", 5, Left, MOD);
-  add("-", 5, Unary, NEG);
-  add("+", 5, Unary, POS);
-  add("~", 6, Unary, NOT);
-  add("**", 7, Right, POW);
-  add("sqrt", 8, Unary, SQRT);
-  add("cos", 8, Unary, COS);
-  add("sin", 8, Unary, SIN);
-  add("tan", 8, Unary, TAN);
-  add("floor", 8, Unary, FLOOR);
-  add("ceil", 8, Unary, CEIL);
-  add("round", 8, Unary, ROUND);
-  addTerminator("(");
-  addTerminator(")");
-  addTerminator("'");
-}
-
-static struct Tree *parse(int prec, struct Reader *reader, struct Value prev) {
+  load(&unaries, unaryOps, COUNT(unaryOps));
+  load(&binaries, binaryOps, COUNT(binaryOps));
+  for (size_t i = 0; i < COUNT(unaryOps); i++) {
+    addStart(unaryOps[i].token[0]);
+  }
+  for (size_t i = 0; i < COUNT(binaryOps); i++) {
+    addStart(binaryOps[i].token[0]);
+  }
+  for (int i = 0; punctuation[i]; i++) {
+    addStart(punctuation[i]);
+  }
+}
+
+// "name = expr" stores the result in a register, returns the name's length
+static int assignment(const char **expression, const char **name) {
+  const char *p = *expression;
+  while (isspace(*p)) {
+    p++;
+  }
+  *name = p;
+  if (!isalpha(*p) && *p != '_') {
+    return 0;
+  }
+  while (isalnum(*p) || *p == '_') {
+    p++;
+  }
+  int len = p - *name;
+  while (isspace(*p)) {
+    p++;
+  }
+  if (*p != '=') {
+    return 0;
+  }
+  *expression = p + 1;
+  // names that start like an operator or pi would never parse back
+  bool reserved = len == 2 && !memcmp(*name, "pi", 2);
+  for (size_t i = 0; i < COUNT(unaryOps); i++) {
+    reserved |= unaryOps[i].len <= len && !memcmp(*name, unaryOps[i].token, unaryOps[i].len);
+  }
+  for (size_t i = 0; i < COUNT(binaryOps); i++) {
+    reserved |= isalpha(binaryOps[i].token[0]) && binaryOps[i].len <= len &&
+                !memcmp(*name, binaryOps[i].token, binaryOps[i].len);
+  }
+  if (reserved) {
+    errorMsg = "Reserved name";
+    return -1;
+  }
+  return len;
+}
+
+static struct Tree *parseAll(struct Reader *reader, struct Shared *prev) {
+  reader->interned = NULL;
+  struct Tree *t = parse(0, reader, prev);
+  if (t != NULL && reader->p != reader->end) {
+    freeTree(t);
+    t = NULL;
+    errorMsg = "Expected operator";
+  }
+  bTreeFree(reader->interned);
+  return t;
+}
+
+static struct Tree *parse(int prec, struct Reader *reader, struct Shared *prev) {
+  if (reader->depth == MAX_DEPTH) {
+    errorMsg = "Too deeply nested";
+    return NULL;
+  }
+  reader->depth++;
   struct Tree *t = primary(reader, prev);
+  reader->depth--;
   if (t == NULL) {
     return NULL;
   }
   struct Token token = next(reader);
-  struct Op *op;
-  while ((op = bTreeSearch(binaries, djb2(token.start, token.len))) != NULL && op->prec >= prec) {
+  const struct Op *op;
+  while ((op = bTreeGet(binaries, bTreeStrKey(token.start, token.len))) != NULL && op->prec >= prec) {
     consume(reader, token);
     int subprec = op->prec;
     if (op->assoc == Left) {
       subprec++;
     }
+    reader->depth++;
     struct Tree *r = parse(subprec, reader, prev);
+    reader->depth--;
     if (r == NULL) {
       freeTree(t);
       return NULL;
     }
-    t = branch(op, t, r);
+    t = branch(reader, op, t, r);
+    if (t == NULL) {
+      return NULL;
+    }
     token = next(reader);
   }
   return t;
 }
 
-static struct Tree *primary(struct Reader *reader, struct Value prev) {
+static struct Tree *primary(struct Reader *reader, struct Shared *prev) {
   // either starts with a unary or a leaf
   struct Token token = next(reader);
   if (token.len == 0) {
     errorMsg = "Unexpected end";
     return NULL;
   }
-  struct Op *op = bTreeSearch(unaries, djb2(token.start, token.len));
+  const struct Op *op = bTreeGet(unaries, bTreeStrKey(token.start, token.len));
+  if (op && op->output == BITFIELD) {
+    consume(reader, token);
+    return parseBitfield(reader, prev, op);
+  }
   if (op) {
     consume(reader, token);
     struct Tree *t = parse(op->prec, reader, prev);
     if (!t) {
       return NULL;
     }
-    return branch(op, t, NULL);
+    return branch(reader, op, t, NULL);
   }
   if (*token.start == '(') {
     consume(reader, token);
@@ -202,6 +1119,7 @@ static struct Tree *primary(struct Reader *reader, struct Value prev) {
       return NULL;
     }
     if (!expect(reader, ')')) {
+      freeTree(t);
       return NULL;
     }
     return t;
@@ -213,6 +1131,19 @@ static struct Tree *primary(struct Reader *reader, struct Value prev) {
       return NULL;
     }
     if (!expect(reader, '\'')) {
+      freeTree(t);
+      return NULL;
+    }
+    return t;
+  }
+  if (*token.start == '"') {
+    consume(reader, token);
+    struct Tree *t = parseString(reader);
+    if (!t) {
+      return NULL;
+    }
+    if (!expect(reader, '"')) {
+      freeTree(t);
       return NULL;
     }
     return t;
@@ -224,37 +1155,78 @@ static struct Tree *primary(struct Reader *reader, struct Value prev) {
   return t;
 }
 
-static struct Token next(struct Reader *reader) {
-  struct Token token;
-  // skip whitespace
-  while (reader->p < reader->end && isspace(*reader->p)) {
-    reader->p++;
-  }
+/**
+ * bitfield(x, lo, len) is the low len bits of x >> lo, so it's parsed as
+ * that shift under a node that keeps the low bits.
+ */
+static struct Tree *parseBitfield(struct Reader *reader, struct Shared *prev, const struct Op *op) {
+  struct Tree *args[3];
+  for (int i = 0; i < 3; i++) {
+    next(reader);  // skips whitespace
+    if (!expect(reader, i ? ',' : '(') || !(args[i] = parse(0, reader, prev))) {
+      while (i--) {
+        freeTree(args[i]);
+      }
+      return NULL;
+    }
+  }
+  if (!expect(reader, ')')) {
+    for (int i = 0; i < 3; i++) {
+      freeTree(args[i]);
+    }
+    return NULL;
+  }
+  struct Tree *shifted = branch(reader, bTreeGet(binaries, bTreeStrKey(">>", 2)), args[0], args[1]);
+  if (!shifted) {
+    freeTree(args[2]);
+    return NULL;
+  }
+  return branch(reader, op, shifted, args[2]);
+}
+
+// length of the longest terminator at p, 0 if none starts there
+static int terminatorAt(const char *p, const char *end) {
+  int len = 0;
+  for (size_t i = 0; i < COUNT(unaryOps); i++) {
+    if (unaryOps[i].len > len && end - p >= unaryOps[i].len &&
+        !memcmp(p, unaryOps[i].token, unaryOps[i].len)) {
+      len = unaryOps[i].len;
+    }
+  }
+  for (size_t i = 0; i < COUNT(binaryOps); i++) {
+    if (binaryOps[i].len > len && end - p >= binaryOps[i].len &&
+        !memcmp(p, binaryOps[i].token, binaryOps[i].len)) {
+      len = binaryOps[i].len;
+    }
+  }
+  if (!len && strchr(punctuation, *p)) {
+    len = 1;
+  }
+  return len;
+}
+
+static struct Token next(struct Reader *reader) {
+  struct Token token;
+  // skip whitespace
+  while (reader->p < reader->end && isspace(*reader->p)) {
+    reader->p++;
+  }
   token.start = reader->p;
   token.len = 0;
   // ended?
   if (reader->p >= reader->end) {
     return token;
   }
-  int tokenPos = -1;
-  for (struct List *t = terminators; t != NULL; t = t->next) {
-    int ofs = findIndexOf(t->token, reader->p);
-    if (ofs > -1) {
-      if (tokenPos == -1 || tokenPos >= ofs) {  // we want the earliest
-        if (tokenPos == ofs) {  // we want the longest
-          if (t->len > token.len) {
-            token.len = t->len;
-          }
-        } else {
-          tokenPos = ofs;
-          token.len = t->len;
-        }
-      }
+  // the earliest terminator, only looked for where one could start
+  for (const char *p = reader->p + strcspn(reader->p, starts); p < reader->end;
+       p += 1 + strcspn(p + 1, starts)) {
+    int len = terminatorAt(p, reader->end);
+    if (len) {
+      token.len = len;
+      return token;
     }
   }
-  if (tokenPos < 0) {  // no terminators found, return remaining string
-    token.len = reader->end - reader->p;
-  }
+  token.len = reader->end - reader->p;  // no terminators found, return remaining string
   return token;
 }
 
@@ -262,24 +1234,6 @@ static void consume(struct Reader *reader, struct Token token) {
   reader->p += token.len;
 }
 
-static int findIndexOf(const char *needle, const char *haystack) {
-  int needleLen = strlen(needle);
-  int end = strlen(haystack) - needleLen;
-  for (int i = 0; i <= end; i++) {
-    bool found = true;
-    for (int j = 0; j < needleLen; j++) {
-      if (haystack[i + j] != needle[j]) {
-        found = false;
-        break;
-      }
-    }
-    if (found) {
-      return i;
-    }
-  }
-  return -1;
-}
-
 static bool expect(struct Reader *reader, char c) {
   static char expected[20];
   if (*reader->p != c) {
@@ -296,31 +1250,260 @@ static bool expect(struct Reader *reader, char c) {
   return true;
 }
 
-static struct Tree *branch(struct Op *op, struct Tree *left, struct Tree *right) {
+static struct Tree *newNode() {
   struct Tree *t = calloc(sizeof(struct Tree), 1);
+  t->refs = 1;
+  return t;
+}
+
+static uint32_t hashNode(struct Tree *t) {
+  if (t->op) {
+    uintptr_t h = (uintptr_t)t->op * 31 + (uintptr_t)t->left * 17 + (uintptr_t)t->right;
+    return h ^ (h >> 32);
+  }
+  if (t->column) {
+    return t->column;
+  }
+  if (t->shared) {
+    uintptr_t h = (uintptr_t)t->shared;
+    return h ^ (h >> 32);
+  }
+  if (t->value.isF) {
+    int size = t->value.f->_mp_size;
+    return djb2((const char *)t->value.f->_mp_d, abs(size) * sizeof(mp_limb_t)) ^
+      size ^ t->value.f->_mp_exp;
+  }
+  int size = t->value.z->_mp_size;
+  return djb2((const char *)t->value.z->_mp_d, abs(size) * sizeof(mp_limb_t)) ^ size;
+}
+
+static bool sameNode(struct Tree *a, struct Tree *b) {
+  if (a->op != b->op) {
+    return false;
+  }
+  if (a->op) {
+    return a->left == b->left && a->right == b->right;
+  }
+  if (a->column || b->column) {
+    return a->column == b->column;
+  }
+  if (a->shared || b->shared) {
+    return a->shared == b->shared;
+  }
+  if (a->value.isF != b->value.isF) {
+    return false;
+  }
+  if (a->value.isF) {
+    return mpf_get_prec(a->value.f) == mpf_get_prec(b->value.f) && !mpf_cmp(a->value.f, b->value.f);
+  }
+  return !mpz_cmp(a->value.z, b->value.z);
+}
+
+static bool hasKey(struct StoreKey k) {
+  return k.a || k.b;
+}
+
+// columns have no key, their values change every row
+static struct StoreKey nodeKey(struct Tree *t) {
+  struct StoreKey none = {0, 0};
+  if (t->op) {
+    if (!hasKey(t->left->key) || (t->right && !hasKey(t->right->key))) {
+      return none;
+    }
+    return storeKeyCombine(t->op->output, t->left->key, t->right ? t->right->key : none);
+  }
+  if (t->column) {
+    return none;
+  }
+  return storeKeyValue(t->shared ? t->shared->value : t->value);
+}
+
+// results also depend on the precision and the modulus, and only =digits accounts for lost bits
+static struct StoreKey contextKey(struct StoreKey k) {
+  return storeKeyCombine(mpf_get_default_prec() * 2 + (digits != 0), k, modKey);
+}
+
+static double secondsSince(struct timespec start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// returns the existing node identical to t if there is one, releasing t
+static struct Tree *intern(struct Reader *reader, struct Tree *t) {
+  uint32_t key = hashNode(t);
+  struct Tree *head = bTreeSearch(reader->interned, key);
+  for (struct Tree *n = head; n != NULL; n = n->chain) {
+    if (sameNode(n, t)) {
+      n->refs++;
+      freeTree(t);
+      return n;
+    }
+  }
+  if (head) {
+    t->chain = head->chain;
+    head->chain = t;
+  } else {
+    bTreeInsert(&reader->interned, key, t);
+  }
+  if (store) {
+    t->key = nodeKey(t);
+  }
+  return t;
+}
+
+// a chain like 1+1+1... parses in a loop, but evaluating it recurses, so height is capped too
+static struct Tree *branch(struct Reader *reader, const struct Op *op, struct Tree *left, struct Tree *right) {
+  int height = left->height;
+  if (right && right->height > height) {
+    height = right->height;
+  }
+  if (height + 1 >= MAX_DEPTH) {
+    errorMsg = "Too deeply nested";
+    freeTree(left);
+    if (right) {
+      freeTree(right);
+    }
+    return NULL;
+  }
+  struct Tree *t = newNode();
   t->op = op;
   t->left = left;
   t->right = right;
-  return t;
+  t->height = height + 1;
+  return intern(reader, t);
+}
+
+// length of a plain decimal or 0x integer, 0 if it's anything else
+static int integerLength(struct Reader *reader, int *base) {
+  const char *p = reader->p;
+  *base = 10;
+  if (p + 1 < reader->end && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+    *base = 16;
+    p += 2;
+  }
+  const char *digits = p;
+  while (p < reader->end && (*base == 16 ? isxdigit(*p) : isdigit(*p))) {
+    p++;
+  }
+  if (p == digits || (p < reader->end && strchr(".eEpP@", *p))) {
+    return 0;
+  }
+  return p - reader->p;
+}
+
+// what name was when the line was first read, if this is it being read again
+static struct Shared *recall(struct Reader *reader, const char *name, int len) {
+  struct Bound *b = reader->bound;
+  for (int i = 0; b && i < b->count; i++) {
+    if (!strncmp(b->names[i], name, len) && !b->names[i][len]) {
+      return b->shared[i];
+    }
+  }
+  return NULL;
+}
+
+static struct Tree *sharedLeaf(struct Reader *reader, struct Shared *s, const char *name,
+                               int len) {
+  if (!settle(&s->value)) {
+    return NULL;
+  }
+  struct Bound *b = reader->bound;
+  if (b && !recall(reader, name, len)) {
+    b->names = realloc(b->names, (b->count + 1) * sizeof(char *));
+    b->shared = realloc(b->shared, (b->count + 1) * sizeof(struct Shared *));
+    b->names[b->count] = strndup(name, len);
+    b->shared[b->count++] = s;
+    s->refs++;
+  }
+  struct Tree *t = newNode();
+  t->shared = s;
+  s->refs++;
+  return intern(reader, t);
+}
+
+// to the default precision, which takes seconds for a million digits
+static void pi(struct Value *v) {
+  struct StoreKey none = {0, 0};
+  struct StoreKey key = contextKey(storeKeyCombine(PI_KEY, none, none));
+  long lost, rounds;
+  if (store && storeFind(store, key, v, &lost, &rounds)) {
+    return;
+  }
+  struct timespec started;
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  valueInitF(v);
+  mpf_pi(v->f);
+  if (store && secondsSince(started) > STORE_SECONDS) {
+    storeInsert(store, key, *v, 0, 0);
+  }
 }
 
-static struct Tree *leaf(struct Reader *reader, struct Value prev) {
+static struct Tree *leaf(struct Reader *reader, struct Shared *prev) {
   struct Value v;
-  mpz_init(v.z);
-  mpf_init(v.f);
-  if (*reader->p == '$') {
-    reader->p++;
-    v.isF = prev.isF;
-    mpf_set(v.f, prev.f);
-    mpz_set(v.z, prev.z);
-  } else if (*reader->p == 'p' && reader->p + 1 < reader->end && reader->p[1] == 'i') {
-    reader->p += 2;
-    v.isF = true;
-    mpf_set_d(v.f, M_PI);
+  int base, len;
+  if (*reader->p == '$' && reader->columns && reader->p + 1 < reader->end &&
+      isdigit(reader->p[1])) {
+    int column = strtol(reader->p + 1, (char **)&reader->p, 10);
+    if (column < 1) {
+      errorMsg = "Unknown column";
+      return NULL;
+    }
+    struct Tree *t = newNode();
+    t->column = column;
+    return intern(reader, t);
+  } else if (*reader->p == '$' && reader->p + 1 < reader->end && isdigit(reader->p[1])) {
+    if (reader->prevColumn) {
+      errorMsg = "Results change from one value to the next";
+      return NULL;
+    }
+    // $1 is the last result, $2 the one before...
+    const char *name = reader->p;
+    long n = strtol(reader->p + 1, (char **)&reader->p, 10);
+    len = reader->p - name;
+    struct Shared *s = recall(reader, name, len);
+    if (!s && n >= 1 && n <= HISTORY_SIZE && n <= results) {
+      s = bTreeSearch(history, results - n + 1);
+    }
+    if (!s) {
+      errorMsg = "No such result";
+      return NULL;
+    }
+    return sharedLeaf(reader, s, name, len);
+  } else if (*reader->p == '$') {
+    const char *name = reader->p++;
+    if (reader->prevColumn) {
+      struct Tree *t = newNode();
+      t->column = 1;
+      return intern(reader, t);
+    }
+    struct Shared *s = recall(reader, name, 1);
+    return sharedLeaf(reader, s ? s : prev, name, 1);
+  } else if (isalpha(*reader->p) || *reader->p == '_') {
+    const char *name = reader->p;
+    while (reader->p < reader->end && (isalnum(*reader->p) || *reader->p == '_')) {
+      reader->p++;
+    }
+    len = reader->p - name;
+    if (len == 2 && !memcmp(name, "pi", 2)) {
+      pi(&v);
+      roundings++;
+    } else {
+      struct Shared *s = recall(reader, name, len);
+      if (!s) {
+        s = bTreeGet(registers, bTreeStrKey(name, len));
+      }
+      if (!s) {
+        static char unknown[40];
+        snprintf(unknown, sizeof(unknown), "Unknown '%.*s'", len, name);
+        errorMsg = unknown;
+        return NULL;
+      }
+      return sharedLeaf(reader, s, name, len);
+    }
   } else if (*reader->p == '0' && reader->p + 1 < reader->end &&
         (reader->p[1] == 'b' || reader->p[1] == 'o')) {  // binary or octal
-    v.isF = false;
-    mpz_set_si(v.z, 0);
+    valueInitZ(&v);
     reader->p++;
     int base = *reader->p++ == 'b' ? 2 : 8;
     char ch;
@@ -329,10 +1512,20 @@ static struct Tree *leaf(struct Reader *reader, struct Value prev) {
       mpz_add_ui(v.z, v.z, ch - '0');
       reader->p++;
     }
+  } else if ((len = integerLength(reader, &base)) > 0) {  // skip mpf entirely
+    char text[64];
+    char *s = len < (int)sizeof(text) ? text : malloc(len + 1);
+    int skip = base == 16 ? 2 : 0;
+    memcpy(s, reader->p + skip, len - skip);
+    s[len - skip] = 0;
+    valueInitZ(&v);
+    mpz_set_str(v.z, s, base);
+    if (s != text) {
+      free(s);
+    }
+    reader->p += len;
   } else {
-    char *end;
-    v.isF = true;
-    int len;
+    valueInitF(&v);
     if (!gmp_sscanf(reader->p, "%Ff%n", v.f, &len) || len == 0) {
       static char unknown[20];
       const char *e = "Unknown '?'";
@@ -342,385 +1535,1347 @@ static struct Tree *leaf(struct Reader *reader, struct Value prev) {
         *sub = *reader->p;
       }
       errorMsg = unknown;
-      mpz_clear(v.z);
-      mpf_clear(v.f);
+      valueClear(&v);
       return NULL;
     }
+    roundings++;
     bool forcedFloat = false;
     for (int i = 0; i < len; i++) {
       if (*reader->p++ == '.') {
         forcedFloat = true;
       }
     }
-    if (mpf_integer_p(v.f) && !forcedFloat) {
-      mpz_set_f(v.z, v.f);
-      v.isF = false;
+    if (mpf_integer_p(v.f) && !forcedFloat && magnitude(v) <= (long)MAX_BITS) {
+      valueToZ(&v);
     }
   }
-  struct Tree *t = calloc(sizeof(struct Tree), 1);
-  t->leaf = v;
-  return t;
+  struct Tree *t = newNode();
+  t->value = v;
+  return intern(reader, t);
 }
 
-static struct Tree *parseChar(struct Reader *reader) {
-  struct Value v;
-  v.isF = false;
-  mpz_init(v.z);
-  mpf_init(v.f);
-  if (reader->p < reader->end && *reader->p != '\'') {
-    if (*reader->p == '\\') {
+// one character or escape of a quoted literal
+static bool parseCodePoint(struct Reader *reader, uint32_t *cp) {
+  if (*reader->p != '\\') {
+    int used = utf8DecodeOne(reader->p, reader->end - reader->p, cp);
+    if (!used) {
+      errorMsg = "Invalid UTF-8";
+      return false;
+    }
+    reader->p += used;
+    return true;
+  }
+  reader->p++;
+  if (reader->p >= reader->end) {
+    errorMsg = "Unclosed quote";
+    return false;
+  }
+  static const char simple[] = "a\ab\bf\fn\nr\rt\tv\v\\\\''\"\"";
+  for (int i = 0; simple[i]; i += 2) {
+    if (*reader->p == simple[i]) {
+      *cp = simple[i + 1];
       reader->p++;
-      if (reader->p >= reader->end) {
-        errorMsg = "Unclosed '";
-        return NULL;
-      }
-      switch (*reader->p) {
-        case 'a':
-          mpz_set_ui(v.z, 7);
-          reader->p++;
-          break;
-        case 'b':
-          mpz_set_ui(v.z, 8);
-          reader->p++;
-          break;
-        case 'f':
-          mpz_set_ui(v.z, 0xc);
-          reader->p++;
-          break;
-        case 'n':
-          mpz_set_ui(v.z, 0xa);
-          reader->p++;
-          break;
-        case 'r':
-          mpz_set_ui(v.z, 0xd);
-          reader->p++;
-          break;
-        case 't':
-          mpz_set_ui(v.z, 9);
-          reader->p++;
-          break;
-        case 'v':
-          mpz_set_ui(v.z, 0xb);
-          reader->p++;
-          break;
-        case '\\':
-          mpz_set_ui(v.z, 0x5c);
-          reader->p++;
-          break;
-        case '\'':
-          mpz_set_ui(v.z, 0x27);
-          reader->p++;
-          break;
-        case 'x':
-        case 'u':
-        case 'U':  // all have a bunch of hex follow
-          {
-            reader->p++;
-            while (reader->p < reader->end) {
-              char c = *reader->p;
-              if (c >= '0' && c <= '9') {
-                mpz_mul_ui(v.z, v.z, 16);
-                mpz_add_ui(v.z, v.z, c - '0');
-              } else if (c >= 'a' && c <= 'f') {
-                mpz_mul_ui(v.z, v.z, 16);
-                mpz_add_ui(v.z, v.z, c - 'a' + 10);
-              } else if (c >= 'A' && c <= 'F') {
-                mpz_mul_ui(v.z, v.z, 16);
-                mpz_add_ui(v.z, v.z, c - 'A' + 10);
-              } else {
-                break;
-              }
-              reader->p++;
-            }
-          }
-          break;
-        default:  // might be octal
-          while (reader->p < reader->end) {
-            char c = *reader->p;
-            if (c >= '0' && c <= '7') {
-              mpz_mul_ui(v.z, v.z, 8);
-              mpz_add_ui(v.z, v.z, c - '0');
-              reader->p++;
-            } else {
-              break;
-            }
-          }
-          break;
-      }
+      return true;
+    }
+  }
+  // hex follows x, u and U, anything else might be octal
+  int base = 8;
+  if (*reader->p == 'x' || *reader->p == 'u' || *reader->p == 'U') {
+    base = 16;
+    reader->p++;
+  }
+  uint64_t v = 0;
+  const char *digits = reader->p;
+  while (reader->p < reader->end) {
+    char c = *reader->p;
+    int digit;
+    if (c >= '0' && c <= '7') {
+      digit = c - '0';
+    } else if (base == 16 && c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (base == 16 && c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (base == 16 && c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
     } else {
-      uint32_t val = 0;
-      // parse utf8
-      switch (*reader->p & 0xf0) {
-        case 0x00:  // ascii
-        case 0x80:  // not utf8
-          val = *reader->p++;
-          break;
-        case 0xc0:  // 2 byte utf8
-          val = (*reader->p++ & 0x1f) << 6;
-          val |= *reader->p++ & 0x3f;
-          break;
-        case 0xe0:  // 3 byte utf8
-          val = (*reader->p++ & 0x1f) << 12;
-          val |= (*reader->p++ & 0x3f) << 6;
-          val |= *reader->p++ & 0x3f;
-          break;
-        case 0xf0:  // 4 byte utf8
-          val = (*reader->p++ & 0xf) << 18;
-          val |= (*reader->p++ & 0x3f) << 12;
-          val |= (*reader->p++ & 0x3f) << 6;
-          val |= *reader->p++ & 0x3f;
-          break;
-      }
-      mpz_set_ui(v.z, val);
+      break;
     }
+    v = v * base + digit;
+    if (v > UINT32_MAX) {
+      errorMsg = "Escape too large";
+      return false;
+    }
+    reader->p++;
   }
-  struct Tree *t = calloc(sizeof(struct Tree), 1);
-  t->leaf = v;
-  return t;
+  if (reader->p == digits) {
+    errorMsg = "Unknown escape";
+    return false;
+  }
+  *cp = v;
+  return true;
+}
+
+static struct Tree *parseChar(struct Reader *reader) {
+  uint32_t cp = 0;
+  if (reader->p < reader->end && *reader->p != '\'' && !parseCodePoint(reader, &cp)) {
+    return NULL;
+  }
+  struct Tree *t = newNode();
+  valueInitZ(&t->value);
+  mpz_set_ui(t->value.z, cp);
+  return intern(reader, t);
+}
+
+/**
+ * A string is its code points packed 32 bits apiece, the first one most
+ * significant, so a one character string is the same as the character.
+ */
+static struct Tree *parseString(struct Reader *reader) {
+  size_t len = reader->end - reader->p;
+  uint32_t *cps = malloc((len + 1) * sizeof(uint32_t));
+  size_t count = 0;
+  while (reader->p < reader->end && *reader->p != '"') {
+    size_t n;
+    reader->p += utf8Decode(reader->p, reader->end - reader->p, '"', cps + count, &n);
+    count += n;
+    if (reader->p < reader->end && *reader->p != '"' && !parseCodePoint(reader, cps + count++)) {
+      free(cps);
+      return NULL;
+    }
+  }
+  struct Tree *t = newNode();
+  valueInitZ(&t->value);
+  mpz_import(t->value.z, count, 1, sizeof(uint32_t), 0, 0, cps);
+  free(cps);
+  return intern(reader, t);
 }
 
 static void freeTree(struct Tree *t) {
+  if (--t->refs > 0) {
+    return;
+  }
   if (t->left) {
     freeTree(t->left);
   }
   if (t->right) {
     freeTree(t->right);
   }
-  if (t->op == NULL) {  // leaf node
-    mpz_clear(t->leaf.z);
-    mpf_clear(t->leaf.f);
+  if (t->shared) {
+    release(t->shared);
+  } else if (t->op == NULL && !t->column) {  // leaf node
+    valueClear(&t->value);
   }
   free(t);
 }
 
+// promotes both sides to floats if either is one
+static bool promote(struct Value *l, struct Value *r) {
+  if (l->isF || r->isF) {
+    valueToF(l);
+    valueToF(r);
+    return true;
+  }
+  return false;
+}
+
+static int sign(struct Value v) {
+  return v.isF ? mpf_sgn(v.f) : mpz_sgn(v.z);
+}
+
+// counts too big for an mp_bitcnt_t saturate, rather than wrapping around
+static mp_bitcnt_t shiftCount(struct Value v) {
+  if (v.isF) {
+    return mpf_fits_ulong_p(v.f) ? mpf_get_ui(v.f) : ULONG_MAX;
+  }
+  return mpz_fits_ulong_p(v.z) ? mpz_get_ui(v.z) : ULONG_MAX;
+}
+
+// how many limbs the bit ops treat z as, at least one
+static size_t limbs(mpz_srcptr z) {
+  size_t n = mpz_size(z);
+  return n ? n : 1;
+}
+
+// k if v is the integer 2^k, -1 otherwise
+static long powerOfTwo(struct Value v) {
+  if (v.isF || mpz_sgn(v.z) <= 0) {
+    return -1;
+  }
+  mp_bitcnt_t k = mpz_scan1(v.z, 0);
+  return k == mpz_sizeinbase(v.z, 2) - 1 ? (long)k : -1;
+}
+
+// a float past MAX_BITS would need more memory than GMP can allocate as an integer
+static bool fitsZ(struct Value v) {
+  if (v.isF && magnitude(v) > (long)MAX_BITS) {
+    errorMsg = "Too big";
+    return false;
+  }
+  return true;
+}
+
+/**
+ * l ** r into l as a float, with the shortcuts for integer, square and
+ * square root powers.  Each gives the correctly rounded result mpf_pow()
+ * would, and an integer power that fits the precision is exact anyway.
+ */
+static bool power(struct Value *l, struct Value *r) {
+  mp_bitcnt_t prec = mpf_get_default_prec();
+  if (optimize && !l->isF && !r->isF && mpz_sgn(r->z) >= 0 && mpz_cmp_ui(r->z, prec) <= 0 &&
+      mpz_sizeinbase(l->z, 2) * mpz_get_ui(r->z) <= prec) {
+    mpz_pow_ui(l->z, l->z, mpz_get_ui(r->z));
+    valueToF(l);
+    return true;
+  }
+  valueToF(l);
+  valueToF(r);
+  if (optimize && mpf_integer_p(r->f) && mpf_fits_slong_p(r->f)) {
+    return mpf_pow_si(l->f, l->f, mpf_get_si(r->f));
+  }
+  if (optimize && !mpf_cmp_d(r->f, 0.5) && mpf_sgn(l->f) >= 0) {
+    mpf_sqrt(l->f, l->f);
+    return true;
+  }
+  return mpf_pow(l->f, l->f, r->f);
+}
+
+static bool toZ(struct Value *v) {
+  if (!fitsZ(*v)) {
+    return false;
+  }
+  valueToZ(v);
+  return true;
+}
+
+// whether shifting l left by count leaves more than limit bits
+static bool shiftsPast(struct Value l, mp_bitcnt_t count, mp_bitcnt_t limit) {
+  if (!sign(l)) {
+    return false;
+  }
+  long bits = magnitude(l);
+  return count > limit || (bits > 0 && bits + count > limit);
+}
+
+/**
+ * Releases one reference to the tree, the caller owns the returned value.
+ * Shared nodes are evaluated once and copied out to every parent but the
+ * last, which gets the original.
+ */
 static struct Value eval(struct Tree *tree) {
-  if (tree->op == NULL) {
-    return tree->leaf;
+  if (tree->shared) {
+    struct Shared *s = tree->shared;
+    s->refs++;
+    freeTree(tree);
+    return take(s);
+  }
+  if (tree->op != NULL) {
+    tree->value = apply(tree);
+    tree->op = NULL;
+    tree->left = NULL;
+    tree->right = NULL;
+  }
+  struct Value v;
+  if (--tree->refs == 0) {
+    v = tree->value;
+    free(tree);
+  } else {
+    valueSet(&v, tree->value);
+  }
+  return v;
+}
+
+/**
+ * Like eval(), but a value something else still holds is lent instead of
+ * copied.  *lent is set to the Shared to release once done with it.
+ */
+static struct Value borrow(struct Tree *tree, struct Shared **lent) {
+  *lent = NULL;
+  if (!tree->shared) {
+    return eval(tree);
+  }
+  struct Shared *s = tree->shared;
+  s->refs++;
+  freeTree(tree);
+  if (s->refs == 1) {
+    return take(s);
+  }
+  *lent = s;
+  return s->value;
+}
+
+// whether the op changes its right operand in place
+static bool changesRight(int output, struct Value l, struct Value r) {
+  switch (output) {
+    case OR:
+    case XOR:
+    case AND:
+    case BITFIELD:
+    case PDEP:
+    case PEXT:
+      return r.isF;
+    case ADD:
+    case SUB:
+    case DIV:
+    case MOD:
+      return l.isF && !r.isF;
+    case MUL:
+      return !r.isF && (l.isF || modulus);
+    case POW:
+      return !r.isF;
+  }
+  return false;
+}
+
+// evaluates a branch, releasing its children
+static struct Value apply(struct Tree *tree) {
+  if (calcStopped()) {  // unwind without doing any more work
+    freeTree(tree->left);
+    if (tree->right) {
+      freeTree(tree->right);
+    }
+    struct Value v;
+    valueInitZ(&v);
+    return v;
   }
-  struct Value l = eval(tree->left);
+  long lostBefore = lostBits, roundingsBefore = roundings;
+  struct StoreKey key = {0, 0};
+  if (store && hasKey(tree->key)) {
+    key = contextKey(tree->key);
+    struct Value v;
+    long lost, rounds;
+    if (storeFind(store, key, &v, &lost, &rounds)) {
+      freeTree(tree->left);
+      if (tree->right) {
+        freeTree(tree->right);
+      }
+      lostBits += lost;
+      roundings += rounds;
+      return v;
+    }
+  }
+  struct Shared *lentL, *lentR = NULL;
+  struct Value l = borrow(tree->left, &lentL);
   struct Value r;
-  if (tree->right) {
-    r = eval(tree->right);
+  bool binary = tree->right != NULL;
+  if (binary) {
+    r = borrow(tree->right, &lentR);
   }
+  int output = tree->op->output;
+  // the result is built in l, so l has to be ours
+  bool commutes = output == OR || output == XOR || output == AND || output == ADD || output == MUL;
+  if (lentL && binary && !lentR && commutes && !l.isF && !r.isF) {
+    struct Value t = l;
+    l = r;
+    r = t;
+    lentR = lentL;
+    lentL = NULL;
+  }
+  if (lentL) {
+    l = take(lentL);
+  }
+  if (lentR && changesRight(output, l, r)) {
+    r = take(lentR);
+    lentR = NULL;
+  }
+  // $ and registers may come from a less precise line
+  if (l.isF && mpf_get_prec(l.f) < mpf_get_default_prec()) {
+    mpf_set_prec(l.f, mpf_get_default_prec());
+  }
+  long el = digits ? magnitude(l) : 0;
+  long er = digits && binary ? magnitude(r) : 0;
+  struct timespec started;
+  if (hasKey(key)) {
+    clock_gettime(CLOCK_MONOTONIC, &started);
+  }
+  long twos;
   // it makes no sense to use most bitwise ops with floats...
-  switch (tree->op->output) {
+  switch (output) {
     case OR:
-      if (l.isF) {
-        mpz_set_f(l.z, l.f);
-        l.isF = false;
+      if (toZ(&l) && toZ(&r)) {
+        mpz_ior(l.z, l.z, r.z);
       }
-      if (r.isF) {
-        mpz_set_f(r.z, r.f);
-      }
-      mpz_ior(l.z, l.z, r.z);
-      return l;
+      break;
     case XOR:
-      if (l.isF) {
-        mpz_set_f(l.z, l.f);
-        l.isF = false;
+      if (toZ(&l) && toZ(&r)) {
+        mpz_xor(l.z, l.z, r.z);
       }
-      if (r.isF) {
-        mpz_set_f(r.z, r.f);
-      }
-      mpz_xor(l.z, l.z, r.z);
-      return l;
+      break;
     case AND:
-      if (l.isF) {
-        mpz_set_f(l.z, l.f);
-        l.isF = false;
+      if (toZ(&l) && toZ(&r)) {
+        mpz_and(l.z, l.z, r.z);
       }
-      if (r.isF) {
-        mpz_set_f(r.z, r.f);
-      }
-      mpz_and(l.z, l.z, r.z);
-      return l;
+      break;
     case SHL:
-      if (l.isF) {
-        mp_bitcnt_t p;
-        if (r.isF) {
-          p = mpf_get_si(r.f);
-        } else {
-          p = mpz_get_si(r.z);
-        }
-        mpf_mul_2exp(l.f, l.f, p);
+      if (sign(r) < 0) {
+        errorMsg = "Negative shift";
+      } else if (l.isF ? shiftsPast(l, shiftCount(r), MAX_EXPONENT) :
+                 modulus && sign(l) && shiftCount(r) == ULONG_MAX) {
+        errorMsg = "Too big";
+      } else if (l.isF) {
+        mpf_mul_2exp(l.f, l.f, shiftCount(r));
+      } else if (modulus) {
+        modShl(modulus, l.z, shiftCount(r));
+      } else if (previewing && shiftsPast(l, shiftCount(r), PREVIEW_BITS)) {
+        errorMsg = "Too big to preview";
+      } else if (shiftsPast(l, shiftCount(r), MAX_BITS)) {
+        errorMsg = "Too big";
       } else {
-        mp_bitcnt_t p;
-        if (r.isF) {
-          p = mpf_get_si(r.f);
-        } else {
-          p = mpz_get_si(r.z);
-        }
-        mpz_mul_2exp(l.z, l.z, p);
+        mpz_mul_2exp(l.z, l.z, shiftCount(r));
       }
-      return l;
+      break;
     case SHR:
-      if (l.isF) {
-        mp_bitcnt_t p;
-        if (r.isF) {
-          p = mpf_get_si(r.f);
-        } else {
-          p = mpz_get_si(r.z);
-        }
-        mpf_div_2exp(l.f, l.f, p);
+      if (sign(r) < 0) {
+        errorMsg = "Negative shift";
+      } else if (l.isF && (shiftCount(r) > MAX_EXPONENT ||
+                           magnitude(l) < (long)shiftCount(r) - MAX_EXPONENT)) {
+        mpf_set_ui(l.f, 0);  // past the smallest exponent a float can have
+      } else if (l.isF) {
+        mpf_div_2exp(l.f, l.f, shiftCount(r));
       } else {
-        mp_bitcnt_t p;
-        if (r.isF) {
-          p = mpf_get_si(r.f);
-        } else {
-          p = mpz_get_si(r.z);
-        }
-        mpz_div_2exp(l.z, l.z, p);
+        mpz_div_2exp(l.z, l.z, shiftCount(r));
       }
-      return l;
+      break;
     case ADD:
-      if (l.isF) {
-        if (!r.isF) {
-          mpf_set_z(r.f, r.z);
-        }
-        mpf_add(l.f, l.f, r.f);
-      } else if (r.isF) {
-        mpf_set_z(l.f, l.z);
-        l.isF = true;
+      if (promote(&l, &r)) {
         mpf_add(l.f, l.f, r.f);
       } else {
         mpz_add(l.z, l.z, r.z);
+        if (modulus) {
+          modReduce(modulus, l.z);
+        }
       }
-      return l;
+      break;
     case SUB:
-      if (l.isF) {
-        if (!r.isF) {
-          mpf_set_z(r.f, r.z);
-        }
-        mpf_sub(l.f, l.f, r.f);
-      } else if (r.isF) {
-        mpf_set_z(l.f, l.z);
-        l.isF = true;
+      if (promote(&l, &r)) {
         mpf_sub(l.f, l.f, r.f);
       } else {
         mpz_sub(l.z, l.z, r.z);
+        if (modulus) {
+          modReduce(modulus, l.z);
+        }
       }
-      return l;
+      break;
     case MUL:
-      if (l.isF) {
-        if (!r.isF) {
-          mpf_set_z(r.f, r.z);
-        }
-        mpf_mul(l.f, l.f, r.f);
-      } else if (r.isF) {
-        mpf_set_z(l.f, l.z);
-        l.isF = true;
+      if (previewing && !l.isF && !r.isF &&
+          mpz_sizeinbase(l.z, 2) + mpz_sizeinbase(r.z, 2) > PREVIEW_BITS) {
+        errorMsg = "Too big to preview";
+      } else if (promote(&l, &r)) {
         mpf_mul(l.f, l.f, r.f);
+      } else if (modulus) {
+        modMul(modulus, l.z, r.z);
+      } else if (optimize && (twos = powerOfTwo(r)) >= 0) {
+        mpz_mul_2exp(l.z, l.z, twos);
+      } else if (optimize && (twos = powerOfTwo(l)) >= 0) {
+        mpz_mul_2exp(l.z, r.z, twos);
       } else {
         mpz_mul(l.z, l.z, r.z);
       }
-      return l;
+      break;
     case DIV:
-      if (l.isF) {
-        if (!r.isF) {
-          mpf_set_z(r.f, r.z);
-        }
-        mpf_div(l.f, l.f, r.f);
-      } else if (r.isF) {
-        mpf_set_z(l.f, l.z);
-        l.isF = true;
+      if (!sign(r)) {
+        errorMsg = "Division by zero";
+      } else if (promote(&l, &r)) {
         mpf_div(l.f, l.f, r.f);
+      } else if (optimize && (twos = powerOfTwo(r)) >= 0) {  // mpz_div floors too
+        mpz_fdiv_q_2exp(l.z, l.z, twos);
       } else {
         mpz_div(l.z, l.z, r.z);
       }
-      return l;
+      break;
     case MOD:
-      if (l.isF) {
-        if (!r.isF) {
-          mpf_set_z(r.f, r.z);
-        }
-        mpf_tdiv_r(l.f, l.f, r.f);
-      } else if (r.isF) {
-        mpf_set_z(l.f, l.z);
-        l.isF = true;
+      if (!sign(r)) {
+        errorMsg = "Division by zero";
+      } else if (promote(&l, &r)) {
         mpf_tdiv_r(l.f, l.f, r.f);
       } else {
         mpz_tdiv_r(l.z, l.z, r.z);
       }
-      return l;
+      break;
     case NEG:
       if (l.isF) {
         mpf_neg(l.f, l.f);
       } else {
         mpz_neg(l.z, l.z);
       }
-      return l;
+      break;
     case POS:  // do nothing
-      return l;
+      break;
     case NOT:
-      if (l.isF) {
-        mpz_set_f(l.z, l.f);
-        l.isF = false;
+      if (toZ(&l)) {
+        mpz_com(l.z, l.z);
       }
-      mpz_com(l.z, l.z);
-      return l;
+      break;
     case POW:
-      if (!l.isF) {
-        mpf_set_z(l.f, l.z);
-        l.isF = true;
+      if (modulus && !l.isF && !r.isF) {
+        if (!modPow(modulus, l.z, r.z)) {
+          errorMsg = "No inverse";
+        }
+        break;
       }
-      if (!r.isF) {
-        mpf_set_z(r.f, r.z);
+      if (!sign(l) && sign(r) < 0) {
+        errorMsg = "Division by zero";
+        break;
       }
-      mpf_pow(l.f, l.f, r.f);
-      return l;
+      if (!power(&l, &r)) {
+        errorMsg = "Not a real number";
+      }
+      break;
     case SQRT:
-      if (!l.isF) {
-        mpf_set_z(l.f, l.z);
-        l.isF = true;
+      if (sign(l) < 0) {
+        errorMsg = "Negative root";
+        break;
       }
+      valueToF(&l);
       mpf_sqrt(l.f, l.f);
-      return l;
+      break;
     case COS:
-      if (!l.isF) {
-        mpf_set_z(l.f, l.z);
-        l.isF = true;
-      }
+      valueToF(&l);
       mpf_cos(l.f, l.f);
-      return l;
+      break;
     case SIN:
-      if (!l.isF) {
-        mpf_set_z(l.f, l.z);
-        l.isF = true;
-      }
+      valueToF(&l);
       mpf_sin(l.f, l.f);
-      return l;
+      break;
     case TAN:
-      if (!l.isF) {
-        mpf_set_z(l.f, l.z);
-        l.isF = true;
+      valueToF(&l);
+      if (!mpf_tan(l.f, l.f)) {
+        errorMsg = "Not a real number";
       }
-      mpf_tan(l.f, l.f);
-      return l;
+      break;
     case FLOOR:
       if (l.isF) {
         mpf_floor(l.f, l.f);
-        mpz_set_f(l.z, l.f);
-        l.isF = false;
+        toZ(&l);
       }
-      return l;
+      break;
     case CEIL:
       if (l.isF) {
         mpf_ceil(l.f, l.f);
-        mpz_set_f(l.z, l.f);
-        l.isF = false;
+        toZ(&l);
       }
-      return l;
+      break;
     case ROUND:
-      if (l.isF) {
-        mpf_round(l.z, l.f);
+      if (l.isF && fitsZ(l)) {
+        mpz_t z;
+        mpz_init(z);
+        mpf_round(z, l.f);
+        mpf_clear(l.f);
+        l.z[0] = z[0];
         l.isF = false;
       }
+      break;
+    // unbounded integers count and reverse over the fewest whole limbs that hold them
+    case POPCNT:
+      if (sign(l) < 0) {
+        errorMsg = "Negative value";
+      } else if (toZ(&l)) {
+        mpz_set_ui(l.z, mpz_popcount(l.z));
+      }
+      break;
+    case CLZ:
+      if (sign(l) < 0) {
+        errorMsg = "Negative value";
+      } else if (toZ(&l)) {
+        mpz_set_ui(l.z, mpz_sgn(l.z) ? limbs(l.z) * GMP_NUMB_BITS - mpz_sizeinbase(l.z, 2) : GMP_NUMB_BITS);
+      }
+      break;
+    case CTZ:
+      if (toZ(&l)) {
+        mpz_set_ui(l.z, mpz_sgn(l.z) ? mpz_scan1(l.z, 0) : GMP_NUMB_BITS);
+      }
+      break;
+    case BSWAP:
+    case BITREV:
+      if (sign(l) < 0) {
+        errorMsg = "Negative value";
+      } else if (toZ(&l)) {
+        (output == BSWAP ? mpz_bswap : mpz_bitrev)(l.z, l.z, limbs(l.z));
+      }
+      break;
+    case BITFIELD:  // l is already shifted down
+      if (sign(r) < 0) {
+        errorMsg = "Negative length";
+      } else if (toZ(&l)) {
+        mpz_fdiv_r_2exp(l.z, l.z, shiftCount(r));
+      }
+      break;
+    case PDEP:
+    case PEXT:
+      if (sign(r) < 0) {
+        errorMsg = "Negative mask";
+      } else if (toZ(&l) && toZ(&r)) {
+        (output == PDEP ? mpz_pdep : mpz_pext)(l.z, l.z, r.z);
+      }
+      break;
+    default:
+      errorMsg = "Unknown operator";
+      break;
+  }
+  if (digits && l.isF) {
+    account(output, el, er, l);
+  }
+  // only this op is timed, so a cheap parent of a slow child isn't kept too
+  if (hasKey(key) && !errorMsg && !stopped && secondsSince(started) > STORE_SECONDS) {
+    storeInsert(store, key, l, lostBits - lostBefore, roundings - roundingsBefore);
+  }
+  if (lentR) {
+    release(lentR);
+  } else if (binary) {
+    valueClear(&r);
+  }
+  return l;
+}
+
+static u128 wrap(u128 x) {
+  return width == 128 ? x : x & (((u128)1 << width) - 1);
+}
+
+// sign extends a wrapped value
+static i128 sext(u128 x) {
+  if (width == 128) {
+    return x;
+  }
+  u128 top = (u128)1 << (width - 1);
+  return (x ^ top) - top;
+}
+
+// the low 128 bits in two's complement, floats are truncated
+static u128 toFixed(struct Value v) {
+  mpz_t t;
+  mpz_srcptr z = v.z;
+  if (v.isF && magnitude(v) > (long)MAX_BITS) {  // far past its precision, the low bits are all 0
+    return 0;
+  }
+  if (v.isF) {
+    mpz_init(t);
+    mpz_set_f(t, v.f);
+    z = t;
+  }
+  u128 x = 0;
+  for (int i = 0; i * GMP_NUMB_BITS < 128; i++) {
+    x |= (u128)mpz_getlimbn(z, i) << (i * GMP_NUMB_BITS);
+  }
+  if (mpz_sgn(z) < 0) {
+    x = -x;
+  }
+  if (v.isF) {
+    mpz_clear(t);
+  }
+  return wrap(x);
+}
+
+static void fixedToValue(struct Value *v, u128 x) {
+  bool neg = widthSigned && sext(x) < 0;
+  if (neg) {
+    x = -(u128)sext(x);  // unsigned, since the most negative value has no signed negation
+  }
+  uint64_t words[2] = {x, x >> 64};
+  mpz_import(v->z, 2, -1, sizeof(uint64_t), 0, 0, words);
+  if (neg) {
+    mpz_neg(v->z, v->z);
+  }
+}
+
+static u128 isqrt(u128 x) {
+  u128 root = 0;
+  u128 bit = (u128)1 << 126;
+  while (bit > x) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (x >= root + bit) {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+static int popcount128(u128 x) {
+  return bitsCount(x) + bitsCount(x >> 64);
+}
+
+// zeros above x within the width
+static int clz128(u128 x) {
+  if (x == 0) {
+    return width;
+  }
+  uint64_t hi = x >> 64;
+  return (hi ? __builtin_clzll(hi) : 64 + __builtin_clzll(x)) - (128 - width);
+}
+
+static int ctz128(u128 x) {
+  if (x == 0) {
+    return width;
+  }
+  return (uint64_t)x ? __builtin_ctzll(x) : 64 + __builtin_ctzll(x >> 64);
+}
+
+static u128 bswap128(u128 x) {
+  return ((u128)__builtin_bswap64(x) << 64 | __builtin_bswap64(x >> 64)) >> (128 - width);
+}
+
+static u128 bitrev128(u128 x) {
+  return ((u128)bitsReverse(x) << 64 | bitsReverse(x >> 64)) >> (128 - width);
+}
+
+static u128 deposit128(u128 x, u128 mask) {
+  uint64_t lo = mask;
+  return bitsDeposit(x, lo) | (u128)bitsDeposit(x >> bitsCount(lo), mask >> 64) << 64;
+}
+
+static u128 extract128(u128 x, u128 mask) {
+  uint64_t lo = mask;
+  return bitsExtract(x, lo) | (u128)bitsExtract(x >> 64, mask >> 64) << bitsCount(lo);
+}
+
+static double toDouble(u128 x) {
+  return widthSigned ? (double)sext(x) : (double)x;
+}
+
+/**
+ * Evaluates the tree in native two's complement arithmetic, wrapping every
+ * result to the current width.  The tree is left intact.
+ */
+static u128 evalFixed(struct Tree *tree) {
+  if (tree->op == NULL) {
+    return toFixed(tree->shared ? tree->shared->value : tree->value);
+  }
+  u128 l = evalFixed(tree->left);
+  u128 r = 0;
+  if (tree->right) {
+    r = evalFixed(tree->right);
+  }
+  switch (tree->op->output) {
+    case OR:
+      return l | r;
+    case XOR:
+      return l ^ r;
+    case AND:
+      return l & r;
+    case SHL:
+      return r >= (u128)width ? 0 : wrap(l << r);
+    case SHR:
+      if (widthSigned) {
+        i128 s = sext(l);
+        return wrap(r >= (u128)width ? (s < 0 ? -1 : 0) : s >> r);
+      }
+      return r >= (u128)width ? 0 : l >> r;
+    case ADD:
+      return wrap(l + r);
+    case SUB:
+      return wrap(l - r);
+    case MUL:
+      return wrap(l * r);
+    case DIV:
+    case MOD:
+      if (r == 0) {
+        errorMsg = "Division by zero";
+        return 0;
+      }
+      if (widthSigned) {
+        i128 a = sext(l), b = sext(r);
+        if (b == -1) {  // avoids trapping on the most negative value
+          return tree->op->output == DIV ? wrap(-l) : 0;
+        }
+        return wrap(tree->op->output == DIV ? a / b : a % b);
+      }
+      return tree->op->output == DIV ? l / r : l % r;
+    case NEG:
+      return wrap(-l);
+    case POS:
+      return l;
+    case NOT:
+      return wrap(~l);
+    case POW:
+      if (widthSigned && sext(r) < 0) {  // only 1 and -1 survive truncation
+        if (l == 1) {
+          return 1;
+        }
+        return sext(l) == -1 ? ((r & 1) ? l : 1) : 0;
+      }
+      {
+        u128 result = 1;
+        for (; r; r >>= 1) {
+          if (r & 1) {
+            result *= l;
+          }
+          l *= l;
+        }
+        return wrap(result);
+      }
+    case SQRT:
+      if (widthSigned && sext(l) < 0) {
+        errorMsg = "Negative root";
+        return 0;
+      }
+      return isqrt(l);
+    case COS:
+      return wrap((i128)cos(toDouble(l)));
+    case SIN:
+      return wrap((i128)sin(toDouble(l)));
+    case TAN:
+      return wrap((i128)tan(toDouble(l)));
+    case FLOOR:
+    case CEIL:
+    case ROUND:
       return l;
+    case POPCNT:
+      return popcount128(l);
+    case CLZ:
+      return clz128(l);
+    case CTZ:
+      return ctz128(l);
+    case BSWAP:
+      return bswap128(l);
+    case BITREV:
+      return bitrev128(l);
+    case BITFIELD:
+      return r >= (u128)width ? l : l & (((u128)1 << r) - 1);
+    case PDEP:
+      return deposit128(l, r);
+    case PEXT:
+      return extract128(l, r);
   }
   errorMsg = "Unknown operator";
   return l;
 }
 
+static int maxColumn(struct Tree *t) {
+  if (t->op == NULL) {
+    return t->column;
+  }
+  int l = maxColumn(t->left);
+  int r = t->right ? maxColumn(t->right) : 0;
+  return l > r ? l : r;
+}
+
+// whether evalBatch() can handle every node
+static bool batchable(struct Tree *t) {
+  if (t->op == NULL) {
+    struct Value v = t->shared ? t->shared->value : t->value;
+    return t->column || (!v.isF && mpz_fits_slong_p(v.z));
+  }
+  switch (t->op->output) {
+    case POW:
+    case SQRT:
+    case COS:
+    case SIN:
+    case TAN:
+      return false;
+  }
+  return batchable(t->left) && (!t->right || batchable(t->right));
+}
+
+/**
+ * Evaluates a batch of rows with int64 columns, flagging the rows that
+ * overflowed or need the arbitrary precision path for another reason.
+ * The loops are kept branch free where possible so they vectorize.
+ */
+static void evalBatch(struct Tree *t, int64_t **columns, int rows, int64_t *out, bool *bad) {
+  if (t->op == NULL) {
+    if (t->column) {
+      memcpy(out, columns[t->column - 1], rows * sizeof(int64_t));
+    } else {
+      int64_t c = mpz_get_si(t->shared ? t->shared->value.z : t->value.z);
+      for (int i = 0; i < rows; i++) {
+        out[i] = c;
+      }
+    }
+    return;
+  }
+  evalBatch(t->left, columns, rows, out, bad);
+  int64_t *r = NULL;
+  if (t->right) {
+    r = malloc(rows * sizeof(int64_t));
+    evalBatch(t->right, columns, rows, r, bad);
+  }
+  switch (t->op->output) {
+    case OR:
+      for (int i = 0; i < rows; i++) {
+        out[i] |= r[i];
+      }
+      break;
+    case XOR:
+      for (int i = 0; i < rows; i++) {
+        out[i] ^= r[i];
+      }
+      break;
+    case AND:
+      for (int i = 0; i < rows; i++) {
+        out[i] &= r[i];
+      }
+      break;
+    case SHL:
+      for (int i = 0; i < rows; i++) {
+        if (r[i] < 0 || r[i] > 62) {
+          bad[i] |= r[i] < 0 || out[i] != 0;
+          out[i] = 0;
+        } else {
+          int64_t s = (uint64_t)out[i] << r[i];
+          bad[i] |= (s >> r[i]) != out[i];
+          out[i] = s;
+        }
+      }
+      break;
+    case SHR:
+      for (int i = 0; i < rows; i++) {
+        bad[i] |= r[i] < 0;
+        out[i] = out[i] >> (r[i] > 63 || r[i] < 0 ? 63 : r[i]);
+      }
+      break;
+    case ADD:
+      for (int i = 0; i < rows; i++) {
+        int64_t s = (uint64_t)out[i] + r[i];
+        bad[i] |= ((out[i] ^ s) & (r[i] ^ s)) < 0;
+        out[i] = s;
+      }
+      break;
+    case SUB:
+      for (int i = 0; i < rows; i++) {
+        int64_t s = (uint64_t)out[i] - r[i];
+        bad[i] |= ((out[i] ^ r[i]) & (out[i] ^ s)) < 0;
+        out[i] = s;
+      }
+      break;
+    case MUL:
+      for (int i = 0; i < rows; i++) {
+        bad[i] |= __builtin_mul_overflow(out[i], r[i], &out[i]);
+      }
+      break;
+    case DIV:  // mpz_div floors
+    case MOD:  // mpz_tdiv_r truncates
+      for (int i = 0; i < rows; i++) {
+        if (r[i] == 0 || (r[i] == -1 && out[i] == INT64_MIN)) {
+          bad[i] = true;
+          out[i] = 0;
+        } else if (t->op->output == MOD) {
+          out[i] %= r[i];
+        } else {
+          int64_t q = out[i] / r[i];
+          if ((out[i] % r[i]) && ((out[i] ^ r[i]) < 0)) {
+            q--;
+          }
+          out[i] = q;
+        }
+      }
+      break;
+    case NEG:
+      for (int i = 0; i < rows; i++) {
+        bad[i] |= out[i] == INT64_MIN;
+        out[i] = -(uint64_t)out[i];
+      }
+      break;
+    case NOT:
+      for (int i = 0; i < rows; i++) {
+        out[i] = ~out[i];
+      }
+      break;
+    case POPCNT:
+      for (int i = 0; i < rows; i++) {
+        bad[i] |= out[i] < 0;
+        out[i] = bitsCount(out[i]);
+      }
+      break;
+    case CLZ:
+      for (int i = 0; i < rows; i++) {
+        bad[i] |= out[i] < 0;
+        out[i] = out[i] ? __builtin_clzll(out[i]) : 64;
+      }
+      break;
+    case CTZ:
+      for (int i = 0; i < rows; i++) {
+        out[i] = out[i] ? __builtin_ctzll(out[i]) : 64;
+      }
+      break;
+    case BSWAP:
+    case BITREV:  // results past INT64_MAX need the full path
+      for (int i = 0; i < rows; i++) {
+        int64_t s = t->op->output == BSWAP ? __builtin_bswap64(out[i]) : bitsReverse(out[i]);
+        bad[i] |= out[i] < 0 || s < 0;
+        out[i] = s;
+      }
+      break;
+    case BITFIELD:
+      for (int i = 0; i < rows; i++) {
+        if (r[i] < 0 || r[i] > 62) {
+          bad[i] |= r[i] < 0 || out[i] < 0;
+        } else {
+          out[i] &= ((int64_t)1 << r[i]) - 1;
+        }
+      }
+      break;
+    case PDEP:
+    case PEXT:  // a non-negative mask keeps the result non-negative too
+      for (int i = 0; i < rows; i++) {
+        bad[i] |= r[i] < 0;
+        out[i] = t->op->output == PDEP ? bitsDeposit(out[i], r[i]) : bitsExtract(out[i], r[i]);
+      }
+      break;
+  }
+  free(r);
+}
+
+// +x and --x are just x
+static struct Tree *simplify(struct Tree *t) {
+  if (t->op == NULL) {
+    return t;
+  }
+  t->left = simplify(t->left);
+  if (t->right) {
+    t->right = simplify(t->right);
+  }
+  struct Tree *x = NULL;
+  if (t->op->output == POS) {
+    x = t->left;
+  } else if (t->op->output == NEG && t->left->op && t->left->op->output == NEG) {
+    x = t->left->left;
+  }
+  if (!x) {
+    return t;
+  }
+  x->refs++;
+  freeTree(t);
+  return x;
+}
+
+// turns a branch into a leaf holding its value, unless working it out is an error each row should report
+static void foldNode(struct Tree *t) {
+  if (t->op == NULL) {
+    return;
+  }
+  struct Value v = eval(bindColumns(t, NULL));
+  if (errorMsg) {
+    errorMsg = NULL;
+    valueClear(&v);
+    return;
+  }
+  freeTree(t->left);
+  if (t->right) {
+    freeTree(t->right);
+  }
+  t->op = NULL;
+  t->left = NULL;
+  t->right = NULL;
+  t->value = v;
+}
+
+/**
+ * Folds the largest subtrees that use no columns, so they're worked out
+ * once rather than for every row.  Returns whether t uses no columns, in
+ * which case the caller folds it or a larger subtree holding it.
+ */
+static bool fold(struct Tree *t) {
+  if (t->op == NULL) {
+    return !t->column;
+  }
+  bool left = fold(t->left);
+  bool right = !t->right || fold(t->right);
+  if (left && right) {
+    return true;
+  }
+  if (left) {
+    foldNode(t->left);
+  }
+  if (right && t->right) {
+    foldNode(t->right);
+  }
+  return false;
+}
+
+static struct Tree *bindColumns(struct Tree *t, struct Value *columns) {
+  struct Tree *c = newNode();
+  c->op = t->op;
+  if (t->op == NULL) {
+    if (t->column) {
+      valueSet(&c->value, columns[t->column - 1]);
+    } else if (t->shared) {
+      c->shared = t->shared;
+      c->shared->refs++;
+    } else {
+      valueSet(&c->value, t->value);
+    }
+  } else {
+    c->left = bindColumns(t->left, columns);
+    if (t->right) {
+      c->right = bindColumns(t->right, columns);
+    }
+  }
+  return c;
+}
+
+/**
+ * Parses an expression once so it can be evaluated for many rows.  $1, $2
+ * and so on refer to the columns of each row.
+ */
+struct Expression *calcCompile(const char *expression) {
+  if (!binaries) {
+    init();
+  }
+  errorMsg = NULL;
+  struct Reader reader = {
+    .p = expression,
+    .end = expression + strlen(expression),
+    .columns = true,
+  };
+  struct Value none;
+  valueInitZ(&none);
+  struct Shared *last = share(none);
+  struct Tree *tree = parseAll(&reader, last);
+  release(last);
+  if (tree == NULL) {
+    return NULL;
+  }
+  startClock();
+  if (optimize) {
+    tree = simplify(tree);
+    if (fold(tree)) {
+      foldNode(tree);
+    }
+  }
+  struct Expression *e = malloc(sizeof(struct Expression));
+  e->tree = tree;
+  e->columns = maxColumn(tree);
+  e->batchable = batchable(tree);
+  return e;
+}
+
+/**
+ * Parses a line once so calcEvalLine() can work it out for many values of
+ * $, with what doesn't use $ worked out up front.  Returns NULL when that
+ * can't give what calculate() would, for assignments, older results and
+ * =digits, as well as on errors, and calculate() has to be used instead.
+ */
+struct Expression *calcCompileLine(const char *expression) {
+  if (!binaries) {
+    init();
+  }
+  errorMsg = NULL;
+  const char *name;
+  if ((digits && !width) || assignment(&expression, &name) != 0) {
+    return NULL;
+  }
+  struct Reader reader = {
+    .p = expression,
+    .end = expression + strlen(expression),
+    .prevColumn = true,
+  };
+  struct Tree *tree = parseAll(&reader, NULL);
+  if (tree == NULL) {
+    return NULL;
+  }
+  startClock();
+  if (optimize) {
+    tree = simplify(tree);
+    // folding works things out the arbitrary precision way
+    if (!width && fold(tree)) {
+      foldNode(tree);
+    }
+  }
+  struct Expression *e = malloc(sizeof(struct Expression));
+  e->tree = tree;
+  e->columns = maxColumn(tree);
+  e->batchable = false;
+  return e;
+}
+
+/**
+ * Like calculate() on the line calcCompileLine() compiled, consuming prev,
+ * which is handed back unchanged if the calculation is stopped.
+ */
+struct Value calcEvalLine(struct Expression *e, struct Value prev) {
+  errorMsg = NULL;
+  startClock();
+  struct Tree *tree = bindColumns(e->tree, &prev);
+  struct Value v;
+  if (width) {
+    valueInitZ(&v);
+    fixedToValue(&v, evalFixed(tree));
+    freeTree(tree);
+  } else {
+    v = eval(tree);
+  }
+  if (stopped) {
+    valueClear(&v);
+    return prev;
+  }
+  valueClear(&prev);
+  return v;
+}
+
+int calcColumns(struct Expression *e) {
+  return e->columns;
+}
+
+/**
+ * Evaluates rows whose columns all fit in int64.  Returns false if the
+ * expression needs calcEvalRow() for every row, otherwise rows that
+ * overflowed are flagged in bad.
+ */
+bool calcEvalBatch(struct Expression *e, int64_t **columns, int rows, int64_t *out, bool *bad) {
+  if (!e->batchable) {
+    return false;
+  }
+  evalBatch(e->tree, columns, rows, out, bad);
+  return true;
+}
+
+struct Value calcEvalRow(struct Expression *e, struct Value *columns) {
+  errorMsg = NULL;
+  startClock();
+  return eval(bindColumns(e->tree, columns));
+}
+
+void calcFree(struct Expression *e) {
+  freeTree(e->tree);
+  free(e);
+}
+
+/**
+ * Switches to fixed width integers of 8 to 128 bits, 0 goes back to
+ * arbitrary precision.
+ */
+bool calcSetWidth(int bits, bool isSigned) {
+  if (bits != 0 && bits != 8 && bits != 16 && bits != 32 && bits != 64 && bits != 128) {
+    return false;
+  }
+  width = bits;
+  widthSigned = isSigned;
+  return true;
+}
+
+// integer results are reduced mod n until this is called with NULL
+void calcSetModulus(mpz_srcptr n) {
+  if (modulus) {
+    modFree(modulus);
+    modulus = NULL;
+  }
+  modKey = (struct StoreKey){0, 0};
+  if (n) {
+    modulus = modCreate(n);
+    struct Value v = {.isF = false};
+    v.z[0] = n[0];
+    modKey = storeKeyValue(v);
+  }
+}
+
+// off leaves out every shortcut, to check they don't change any results
+void calcSetOptimize(bool on) {
+  optimize = on;
+}
+
+void calcSetStore(struct Store *s) {
+  store = s;
+}
+
+static void startClock() {
+  interrupted = 0;
+  stopped = false;
+  if (timeLimit > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    double whole;
+    deadline.tv_nsec += modf(timeLimit, &whole) * 1e9;
+    deadline.tv_sec += whole + deadline.tv_nsec / 1000000000;
+    deadline.tv_nsec %= 1000000000;
+  }
+}
+
+/**
+ * Safe to call from a signal handler.  The calculation in progress stops at
+ * its next operation and reports an error.
+ */
+void calcInterrupt() {
+  interrupted = 1;
+}
+
+// every calculation after this one gets at most this many seconds, 0 for none
+void calcSetTimeLimit(double seconds) {
+  timeLimit = seconds;
+}
+
+// calculations stop when fd has input waiting, until this is called with -1
+void calcStopOnInput(int fd) {
+  stopInput = fd;
+}
+
+// for printing on its own, which calcStopped() checks as it goes
+void calcStartClock() {
+  startClock();
+}
+
+// whether stopInput has input waiting, checked every INPUT_CHECKS calls
+static bool inputWaiting() {
+  static _Thread_local unsigned checks = 0;
+  if (stopInput < 0 || ++checks % INPUT_CHECKS) {
+    return false;
+  }
+  struct pollfd pending = {stopInput, POLLIN, 0};
+  return poll(&pending, 1, 0) > 0;
+}
+
+/**
+ * Whether the current calculation has been interrupted, ran out of time or
+ * has input waiting to replace it.  Checked between operations, and by
+ * anything else that runs long enough to need it.
+ */
+bool calcStopped() {
+  if (stopped) {
+    return true;
+  }
+  if (interrupted) {
+    errorMsg = "Interrupted";
+    stopped = true;
+  } else if (inputWaiting()) {
+    errorMsg = "Input waiting";
+    stopped = true;
+  } else if (timeLimit > 0) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > deadline.tv_sec ||
+        (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec)) {
+      errorMsg = "Time limit exceeded";
+      stopped = true;
+    }
+  }
+  return stopped;
+}
+
+/**
+ * Adds a result to the history, where $1 finds it until the next one.  Only
+ * the last HISTORY_SIZE results are kept.
+ */
+void calcRemember(struct Value v) {
+  struct Value copy;
+  calcCopy(&copy, v);
+  results++;
+  struct Shared *s = share(copy);
+  bTreeInsert(&history, results, s);
+  if (results > HISTORY_SIZE) {
+    release(bTreeRemove(&history, bTreeIntKey(results - HISTORY_SIZE)));
+  }
+}
+
+/**
+ * Float results are evaluated at whatever precision gets this many
+ * significant digits in base right, 0 goes back to the default precision.
+ */
+bool calcSetDigits(int n, int base) {
+  if (n < 0 || n > MAX_DIGITS) {
+    return false;
+  }
+  digits = n;
+  digitsBase = base;
+  return true;
+}
+
+// changes whenever a register is assigned, results that used one are stale
+unsigned calcGeneration() {
+  return generation;
+}
+
 const char *calcError() {
   return errorMsg;
 }
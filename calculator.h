@@ -5,11 +5,54 @@
 #include <stdbool.h>
 #include <gmp.h>
 
+struct Pending;
+
+/**
+ * Only the member selected by isF is initialized.  Use valueToZ() and
+ * valueToF() to switch representations in place.  A result the double fast
+ * path vouched for holds only a double's worth, and pending says how to
+ * work out the rest, which calcSettle() does.
+ */
 struct Value {
   bool isF;
-  mpz_t z;
-  mpf_t f;
+  union {
+    mpz_t z;
+    mpf_t f;
+  };
+  struct Pending *pending;  // NULL when it holds all of its value
 };
 
 extern struct Value calculate(const char *expression, struct Value prev);
+extern struct Value calcPreview(const char *expression, struct Value prev);
+extern void valueInitZ(struct Value *v);
+extern void valueInitF(struct Value *v);
+extern void valueSet(struct Value *v, struct Value src);
+extern void valueClear(struct Value *v);
+extern void valueToZ(struct Value *v);
+extern void valueToF(struct Value *v);
+struct Expression;
+struct Store;
+
 extern const char *calcError();
+extern struct Expression *calcCompile(const char *expression);
+extern int calcColumns(struct Expression *e);
+extern bool calcEvalBatch(struct Expression *e, int64_t **columns, int rows, int64_t *out, bool *bad);
+extern struct Value calcEvalRow(struct Expression *e, struct Value *columns);
+extern struct Expression *calcCompileLine(const char *expression);
+extern struct Value calcEvalLine(struct Expression *e, struct Value prev);
+extern void calcFree(struct Expression *e);
+extern void calcSetModulus(mpz_srcptr n);
+extern void calcSetStore(struct Store *store);
+extern void calcSetOptimize(bool on);
+extern bool calcSetWidth(int bits, bool isSigned);
+extern bool calcSetDigits(int n, int base);
+extern void calcRemember(struct Value v);
+extern bool calcPartial(struct Value v);
+extern void calcSettle(struct Value *v);
+extern void calcCopy(struct Value *v, struct Value src);
+extern unsigned calcGeneration();
+extern void calcInterrupt();
+extern void calcSetTimeLimit(double seconds);
+extern void calcStopOnInput(int fd);
+extern void calcStartClock();
+extern bool calcStopped();
@@ -0,0 +1,331 @@
+/** @copyright 2025 Sean Kasun */
+#include "convert.h"
+#include <ctype.h>
+#include <gmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ONES 0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+struct Writer {
+  FILE *out;
+  size_t len;
+  char buf[1 << 16];
+};
+
+struct Buffer {
+  char *data;
+  size_t len;
+  size_t cap;
+};
+
+static void flush(struct Writer *w) {
+  fwrite(w->buf, 1, w->len, w->out);
+  w->len = 0;
+}
+
+static void emit(struct Writer *w, const char *s, size_t len) {
+  if (w->len + len > sizeof(w->buf)) {
+    flush(w);
+    if (len > sizeof(w->buf)) {
+      fwrite(s, 1, len, w->out);
+      return;
+    }
+  }
+  memcpy(w->buf + w->len, s, len);
+  w->len += len;
+}
+
+static int specBase(const char *spec, int len) {
+  if (len == 1) {
+    switch (*spec) {
+      case 'd':
+        return 10;
+      case 'h':
+      case 'x':
+        return 16;
+      case 'o':
+      case '8':
+        return 8;
+      case 'b':
+      case '2':
+        return 2;
+    }
+  } else if (len == 2 && !memcmp(spec, "10", 2)) {
+    return 10;
+  } else if (len == 2 && !memcmp(spec, "16", 2)) {
+    return 16;
+  }
+  return 0;
+}
+
+// accepts "h:d", "16:10" and so on
+bool parseConvertSpec(const char *spec, int *from, int *to) {
+  const char *colon = strchr(spec, ':');
+  if (!colon) {
+    return false;
+  }
+  *from = specBase(spec, colon - spec);
+  *to = specBase(colon + 1, strlen(colon + 1));
+  return *from && *to;
+}
+
+static char prefixChar(int base) {
+  switch (base) {
+    case 16:
+      return 'x';
+    case 8:
+      return 'o';
+    case 2:
+      return 'b';
+  }
+  return 0;
+}
+
+// the high bit of each byte is set where lo <= byte <= hi, bytes must be ascii
+static inline uint64_t inRange(uint64_t x, uint8_t lo, uint8_t hi) {
+  uint64_t above = x + ONES * (0x80 - lo);
+  uint64_t over = x + ONES * (0x7f - hi);
+  return above & ~over & HIGHS;
+}
+
+// parses 8 decimal digits at once, returns false if any aren't digits
+static inline bool parseDec8(const char *p, uint64_t *out) {
+  uint64_t x;
+  memcpy(&x, p, 8);
+  if ((x & HIGHS) || inRange(x, '0', '9') != HIGHS) {
+    return false;
+  }
+  x = ((x & 0x0f0f0f0f0f0f0f0fULL) * 2561) >> 8;
+  x = ((x & 0x00ff00ff00ff00ffULL) * 6553601) >> 16;
+  *out = ((x & 0x0000ffff0000ffffULL) * 42949672960001ULL) >> 32;
+  return true;
+}
+
+// parses 8 hex digits at once, returns false if any aren't hex digits
+static inline bool parseHex8(const char *p, uint64_t *out) {
+  uint64_t x;
+  memcpy(&x, p, 8);
+  if (x & HIGHS) {
+    return false;
+  }
+  uint64_t digits = inRange(x, '0', '9');
+  uint64_t letters = inRange(x | (ONES * 0x20), 'a', 'f');
+  if ((digits | letters) != HIGHS) {
+    return false;
+  }
+  // nibble per byte, first character in the lowest byte
+  x = (x & (ONES * 0x0f)) + (letters >> 7) * 9;
+  // pack pairs, then quads, then the two halves
+  x = ((x & 0x00ff00ff00ff00ffULL) << 4) | ((x >> 8) & 0x00ff00ff00ff00ffULL);
+  x = ((x & 0x0000ffff0000ffffULL) << 8) | ((x >> 16) & 0x0000ffff0000ffffULL);
+  *out = ((x & 0xffffffffULL) << 16) | (x >> 32);
+  return true;
+}
+
+static inline int digitValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  c |= 0x20;
+  if (c >= 'a' && c <= 'z') {
+    return c - 'a' + 10;
+  }
+  return 99;
+}
+
+// the caller guarantees len digits can't overflow 64 bits
+static bool parseWord(const char *p, size_t len, int base, uint64_t *out) {
+  uint64_t v = 0;
+  uint64_t chunk;
+  if (base == 10) {
+    for (; len >= 8; p += 8, len -= 8) {
+      if (!parseDec8(p, &chunk)) {
+        return false;
+      }
+      v = v * 100000000 + chunk;
+    }
+  } else if (base == 16) {
+    for (; len >= 8; p += 8, len -= 8) {
+      if (!parseHex8(p, &chunk)) {
+        return false;
+      }
+      v = (v << 32) | chunk;
+    }
+  }
+  for (; len > 0; p++, len--) {
+    int d = digitValue(*p);
+    if (d >= base) {
+      return false;
+    }
+    v = v * base + d;
+  }
+  *out = v;
+  return true;
+}
+
+// writes the digits right-aligned ending at end, returns the start
+static char *formatWord(char *end, uint64_t v, int base) {
+  static const char hex[] = "0123456789abcdef";
+  static const char pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+  char *p = end;
+  if (base == 10) {
+    while (v >= 100) {
+      p -= 2;
+      memcpy(p, pairs + (v % 100) * 2, 2);
+      v /= 100;
+    }
+    if (v >= 10) {
+      p -= 2;
+      memcpy(p, pairs + v * 2, 2);
+    } else {
+      *--p = '0' + v;
+    }
+    return p;
+  }
+  int shift = base == 16 ? 4 : base == 8 ? 3 : 1;
+  uint64_t mask = base - 1;
+  do {
+    *--p = hex[v & mask];
+    v >>= shift;
+  } while (v);
+  return p;
+}
+
+static void emitPrefix(struct Writer *w, bool neg, int base) {
+  char pre[3];
+  int len = 0;
+  if (neg) {
+    pre[len++] = '-';
+  }
+  if (prefixChar(base)) {
+    pre[len++] = '0';
+    pre[len++] = prefixChar(base);
+  }
+  emit(w, pre, len);
+}
+
+static size_t maxWordDigits(int base) {
+  switch (base) {
+    case 10:
+      return 19;
+    case 16:
+      return 16;
+    case 8:
+      return 21;
+  }
+  return 64;
+}
+
+static bool convertToken(struct Writer *w, struct Buffer *scratch, mpz_t z,
+                         const char *p, size_t len, int from, int to) {
+  bool neg = false;
+  if (len && (*p == '-' || *p == '+')) {
+    neg = *p == '-';
+    p++;
+    len--;
+  }
+  char pre = prefixChar(from);
+  if (pre && len >= 2 && p[0] == '0' && (p[1] | 0x20) == pre) {
+    p += 2;
+    len -= 2;
+  }
+  if (len == 0) {
+    return false;
+  }
+  while (len > 1 && *p == '0') {
+    p++;
+    len--;
+  }
+  if (len <= maxWordDigits(from)) {
+    uint64_t v;
+    if (!parseWord(p, len, from, &v)) {
+      return false;
+    }
+    char digits[64];
+    char *start = formatWord(digits + sizeof(digits), v, to);
+    emitPrefix(w, neg && v, to);
+    emit(w, start, digits + sizeof(digits) - start);
+    return true;
+  }
+  // too big for a word, hand it to gmp
+  if (scratch->cap < len + 1) {
+    scratch->cap = len + 1;
+    scratch->data = realloc(scratch->data, scratch->cap);
+  }
+  memcpy(scratch->data, p, len);
+  scratch->data[len] = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (digitValue(p[i]) >= from) {
+      return false;
+    }
+  }
+  mpz_set_str(z, scratch->data, from);
+  char *s = mpz_get_str(NULL, to, z);
+  emitPrefix(w, neg, to);
+  emit(w, s, strlen(s));
+  free(s);
+  return true;
+}
+
+/**
+ * Converts every whitespace separated number in the stream from one base to
+ * another, leaving the whitespace as is.  Output matches printValue().
+ */
+bool convertStream(FILE *in, FILE *out, int from, int to) {
+  struct Writer *w = malloc(sizeof(struct Writer));
+  w->out = out;
+  w->len = 0;
+  struct Buffer input = {malloc(1 << 16), 0, 1 << 16};
+  struct Buffer scratch = {NULL, 0, 0};
+  mpz_t z;
+  mpz_init(z);
+  bool ok = true;
+  bool eof = false;
+  while (!eof) {
+    if (input.len == input.cap) {  // a single token filled the buffer
+      input.cap *= 2;
+      input.data = realloc(input.data, input.cap);
+    }
+    size_t got = fread(input.data + input.len, 1, input.cap - input.len, in);
+    eof = got == 0;
+    input.len += got;
+    const char *p = input.data;
+    const char *end = input.data + input.len;
+    while (p < end) {
+      const char *space = p;
+      while (space < end && isspace(*space)) {
+        space++;
+      }
+      emit(w, p, space - p);
+      const char *tok = space;
+      while (tok < end && !isspace(*tok)) {
+        tok++;
+      }
+      if (tok == end && !eof) {  // token may continue in the next read
+        p = space;
+        break;
+      }
+      if (tok != space && !convertToken(w, &scratch, z, space, tok - space, from, to)) {
+        flush(w);
+        fflush(out);
+        fprintf(stderr, "error: Invalid number '%.*s'\n", (int)(tok - space), space);
+        ok = false;
+      }
+      p = tok;
+    }
+    input.len = end - p;
+    memmove(input.data, p, input.len);
+  }
+  flush(w);
+  mpz_clear(z);
+  free(scratch.data);
+  free(input.data);
+  free(w);
+  return ok;
+}
@@ -0,0 +1,8 @@
+/** @copyright 2025 Sean Kasun */
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+extern bool parseConvertSpec(const char *spec, int *from, int *to);
+extern bool convertStream(FILE *in, FILE *out, int from, int to);
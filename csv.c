@@ -0,0 +1,165 @@
+/** @copyright 2025 Sean Kasun */
+#include "csv.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BATCH 1024
+
+struct Batch {
+  int rows;
+  int columns;
+  char *lines[BATCH];
+  int64_t **cells;  // cells[column][row]
+  int64_t out[BATCH];
+  bool bad[BATCH];
+};
+
+// finds the nth field, trimmed, returns false if the row is too short
+static bool field(const char *line, char delimiter, int n, const char **start, int *len) {
+  for (; n > 0; n--) {
+    line = strchr(line, delimiter);
+    if (!line) {
+      return false;
+    }
+    line++;
+  }
+  const char *end = strchr(line, delimiter);
+  if (!end) {
+    end = line + strlen(line);
+  }
+  while (line < end && isspace(*line)) {
+    line++;
+  }
+  while (end > line && isspace(end[-1])) {
+    end--;
+  }
+  *start = line;
+  *len = end - line;
+  return true;
+}
+
+static bool parseInt64(const char *p, int len, int64_t *out) {
+  bool neg = len > 0 && *p == '-';
+  int i = neg || (len > 0 && *p == '+');
+  if (i == len) {
+    return false;
+  }
+  uint64_t v = 0;
+  for (; i < len; i++) {
+    if (p[i] < '0' || p[i] > '9' || v > (UINT64_MAX - 9) / 10) {
+      return false;
+    }
+    v = v * 10 + p[i] - '0';
+  }
+  if (v > (uint64_t)INT64_MAX + neg) {
+    return false;
+  }
+  *out = neg ? -v : v;
+  return true;
+}
+
+// the slow path, every referenced cell goes through the regular parser
+static void evalRow(FILE *out, struct Expression *e, const char *line, char delimiter, int columns,
+                    struct Format *format) {
+  struct Value *values = malloc(columns * sizeof(struct Value));
+  int bound = 0;
+  const char *err = NULL;
+  for (; bound < columns && !err; bound++) {
+    const char *start;
+    int len;
+    if (!field(line, delimiter, bound, &start, &len)) {
+      err = "Missing column";
+      break;
+    }
+    char *cell = strndup(start, len);
+    struct Value none;
+    valueInitZ(&none);
+    values[bound] = calculate(cell, none);
+    free(cell);
+    err = calcError();
+  }
+  if (!err) {
+    struct Value v = calcEvalRow(e, values);
+    err = calcError();
+    if (!err) {
+      printValue(out, v, format);
+    }
+    valueClear(&v);
+  }
+  if (err) {  // keep the output lined up with the input
+    fprintf(stderr, "error: %s\n", err);
+    fputc('\n', out);
+  }
+  for (int i = 0; i < bound; i++) {
+    valueClear(&values[i]);
+  }
+  free(values);
+}
+
+static void flushBatch(FILE *out, struct Batch *b, struct Expression *e, char delimiter,
+                       struct Format *format) {
+  bool batched = format->base == 10 && !format->unicode &&
+    calcEvalBatch(e, b->cells, b->rows, b->out, b->bad);
+  for (int i = 0; i < b->rows; i++) {
+    if (batched && !b->bad[i]) {
+      fprintf(out, "%" PRId64 "\n", b->out[i]);
+    } else {
+      evalRow(out, e, b->lines[i], delimiter, b->columns, format);
+    }
+    free(b->lines[i]);
+  }
+  b->rows = 0;
+}
+
+/**
+ * Evaluates the expression once per row of delimited input, with $1, $2...
+ * bound to the row's columns.  Rows whose cells all fit in int64 are
+ * evaluated a batch at a time, the rest fall back to full precision.
+ */
+bool runCsv(FILE *in, FILE *out, const char *expression, char delimiter, struct Format *format) {
+  struct Expression *e = calcCompile(expression);
+  if (!e) {
+    fprintf(stderr, "error: %s\n", calcError());
+    return false;
+  }
+  struct Batch *b = calloc(1, sizeof(struct Batch));
+  b->columns = calcColumns(e);
+  b->cells = malloc(b->columns * sizeof(int64_t *));
+  for (int c = 0; c < b->columns; c++) {
+    b->cells[c] = calloc(BATCH, sizeof(int64_t));
+  }
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+  while ((len = getline(&line, &cap, in)) >= 0) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+      line[--len] = 0;
+    }
+    int row = b->rows++;
+    b->lines[row] = line;
+    b->bad[row] = false;
+    for (int c = 0; c < b->columns && !b->bad[row]; c++) {
+      const char *start;
+      int flen;
+      b->bad[row] = !field(line, delimiter, c, &start, &flen) ||
+        !parseInt64(start, flen, &b->cells[c][row]);
+    }
+    line = NULL;
+    cap = 0;
+    if (b->rows == BATCH) {
+      flushBatch(out, b, e, delimiter, format);
+    }
+  }
+  free(line);
+  flushBatch(out, b, e, delimiter, format);
+  for (int c = 0; c < b->columns; c++) {
+    free(b->cells[c]);
+  }
+  free(b->cells);
+  free(b);
+  calcFree(e);
+  return true;
+}
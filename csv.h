@@ -0,0 +1,8 @@
+/** @copyright 2025 Sean Kasun */
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "output.h"
+
+extern bool runCsv(FILE *in, FILE *out, const char *expression, char delimiter, struct Format *format);
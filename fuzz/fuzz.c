@@ -0,0 +1,79 @@
+/** @copyright 2025 Sean Kasun */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <gmp.h>
+#include "calculator.h"
+
+/**
+ * libFuzzer entry point, each input is one line for calculate().  Besides
+ * crashes, an input fails when it takes longer than a fixed allowance plus
+ * a little per byte.  Work that grows faster than the line does is what
+ * turns a long line into a hang, so the fuzzer is steered towards those.
+ * It also fails as soon as GMP and MPFR ask for more memory than the
+ * calculator's size limits allow, before the machine runs out of it.
+ */
+
+#define BASE_MS 100.0  // short lines that do a lot of arithmetic
+#define MS_PER_BYTE 0.01
+#define MAX_GMP_BYTES ((size_t)3 << 29)  // three integers at the 2^32 bit limit, 1.5GiB
+
+static size_t gmpBytes = 0;  // what GMP and MPFR hold right now
+
+static void checkGmpBytes(size_t adding) {
+  if (gmpBytes + adding > MAX_GMP_BYTES) {
+    fprintf(stderr, "error: GMP asked for %zu bytes while holding %zu, over the %zu allowed\n",
+            adding, gmpBytes, MAX_GMP_BYTES);
+    abort();
+  }
+  gmpBytes += adding;
+}
+
+static void *capAlloc(size_t n) {
+  checkGmpBytes(n);
+  return malloc(n);
+}
+
+static void *capRealloc(void *p, size_t old, size_t n) {
+  gmpBytes -= old;
+  checkGmpBytes(n);
+  return realloc(p, n);
+}
+
+static void capFree(void *p, size_t n) {
+  gmpBytes -= n;
+  free(p);
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  static bool capped = false;
+  if (!capped) {  // before the calculator holds anything GMP allocated
+    mp_set_memory_functions(capAlloc, capRealloc, capFree);
+    capped = true;
+  }
+  char *line = malloc(size + 1);
+  memcpy(line, data, size);
+  line[size] = 0;
+  struct Value prev;
+  valueInitZ(&prev);
+  double start = now();
+  prev = calculate(line, prev);
+  double ms = (now() - start) * 1000;
+  valueClear(&prev);
+  free(line);
+  double allowed = BASE_MS + MS_PER_BYTE * size;
+  if (ms > allowed) {
+    fprintf(stderr, "error: %zu bytes took %.1fms, over the %.1fms allowed\n", size, ms, allowed);
+    abort();
+  }
+  return 0;
+}
@@ -0,0 +1,87 @@
+/** @copyright 2025 Sean Kasun */
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/**
+ * Runs files through the fuzz target without libFuzzer, so the corpus of
+ * inputs that once crashed or took too long is replayed by every build.
+ *
+ *   zx_fuzz_replay FILE_OR_DIR...
+ */
+
+extern int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static bool replayFile(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "error: Can't read %s\n", path);
+    return false;
+  }
+  char *data = NULL;
+  size_t len = 0, cap = 0, n;
+  do {
+    if (len == cap) {
+      cap = cap ? cap * 2 : 4096;
+      data = realloc(data, cap);
+    }
+    n = fread(data + len, 1, cap - len, f);
+    len += n;
+  } while (n);
+  fclose(f);
+  printf("%s\n", path);
+  fflush(stdout);  // so a crash shows which input it was
+  LLVMFuzzerTestOneInput((const uint8_t *)data, len);
+  free(data);
+  return true;
+}
+
+static int byName(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// files in the order they sort, so runs are repeatable
+static bool replayDir(const char *path) {
+  DIR *dir = opendir(path);
+  if (!dir) {
+    fprintf(stderr, "error: Can't read %s\n", path);
+    return false;
+  }
+  char **names = NULL;
+  size_t count = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    names = realloc(names, (count + 1) * sizeof(char *));
+    names[count] = malloc(strlen(path) + strlen(entry->d_name) + 2);
+    sprintf(names[count++], "%s/%s", path, entry->d_name);
+  }
+  closedir(dir);
+  qsort(names, count, sizeof(char *), byName);
+  bool ok = true;
+  for (size_t i = 0; i < count; i++) {
+    ok = replayFile(names[i]) && ok;
+    free(names[i]);
+  }
+  free(names);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  bool ok = true;
+  for (int i = 1; i < argc; i++) {
+    struct stat st;
+    if (!stat(argv[i], &st) && S_ISDIR(st.st_mode)) {
+      ok = replayDir(argv[i]) && ok;
+    } else {
+      ok = replayFile(argv[i]) && ok;
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -1,5 +1,8 @@
 /** @copyright 2025 Sean Kasun */
 #include <ctype.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -7,9 +10,21 @@
 #include <gmp.h>
 #include <readline/readline.h>
 #include <readline/history.h>
+#include "cache.h"
 #include "calculator.h"
+#include "convert.h"
+#include "csv.h"
+#include "output.h"
+#include "queue.h"
+#include "store.h"
+#include "wire.h"
 
 #define VERSION "1.1"
+#define HISTORY_LINES 1000
+#define PREVIEW_SECONDS 0.005  // a preview that takes longer is dropped
+#define MAX_MODULUS_BITS (1L << 32)
+#define SUMMARY_DIGITS 1000  // longer integers are summarized at the prompt
+#define PIPELINE_DEPTH 1024  // lines each stage can get ahead of the next
 
 static void printHelp() {
   fprintf(stdout, "Calculator usage\n"
@@ -25,133 +40,296 @@ static void printHelp() {
           "floor 1.9 - round down\n"
           "ceil 1.4 - round up\n"
           "round 0.5 - round to nearest\n"
+          "'a' - unicode value of a character\n"
+          "\"hi\" - unicode values of a string, 32 bits apiece\n"
           "0x20 | 7 - bitwise OR\n"
           "61 & 0xf - bitwise AND\n"
           "61 ^ 0x55 - bitwise XOR\n"
           "~0xff - bitwise NOT\n"
           "1 << 4 - bitwise shift left\n"
           "0x10 >> 4 - bitwise shift right\n"
+          "popcnt 0xff - count the set bits, also clz and ctz for leading and trailing zeros\n"
+          "bswap 0x1234 - reverse the bytes, bitrev reverses the bits\n"
+          "bitfield(x, 4, 8) - the 8 bits of x starting at bit 4\n"
+          "x pdep 0xf0 - deposit the low bits of x at the set bits of 0xf0, pext extracts them\n"
           "help - this help\n"
           "=d - output decimal\n"
           "=h - output hex\n"
           "=o - output octal\n"
           "=b - output binary\n"
-          "=u - output result as unicode character\n"
+          "=u - output result as unicode characters\n"
+          "=i32 - wrap integers to 32 bits, also =i8 to =i128 and =u8 to =u128\n"
+          "=int - go back to unbounded integers\n"
+          "=digits 30 - get 30 significant digits of floats right, =digits alone turns it off\n"
+          "=mod 97 - reduce integer results modulo 97, =mod alone turns it off\n"
+          "$ or $1 - the last result, $2 the one before and so on\n"
+          "full - print the last result in full, huge integers are only summarized\n"
+          "x = 5 - store a result in x for later lines\n"
           );
 }
 
+static volatile sig_atomic_t busy = 0;  // a line is being evaluated
+
 struct State {
-  int base;
-  bool unicode;
+  struct Format format;
+  bool wireOut;
+  unsigned modEpoch;  // bumped whenever the modulus changes
+  bool widthSigned;  // =i rather than =u, the width alone doesn't say
+  struct Cache *cache;
   struct Value prev;
+  double timeout;  // seconds a line may take, 0 for no limit
+  struct Queue *results;  // to the formatter thread when pipelined, otherwise NULL
+  struct Queue *formatted;  // cache misses on their way back from it
 };
 
-static void printBase(int base) {
-  switch (base) {
-    case 16:
-      fwrite("0x", 1, 2, stdout);
-      break;
-    case 2:
-      fwrite("0b", 1, 2, stdout);
-      break;
-    case 8:
-      fwrite("0o", 1, 2, stdout);
-      break;
+/**
+ * What the formatter thread writes for a line.  A result prints error if
+ * it's set, otherwise value in format.  Text is written as it is.
+ */
+struct Output {
+  enum {OutResult, OutError, OutText, OutHelp} kind;
+  struct Value value;
+  struct Format format;
+  char *error;
+  char *text;
+  size_t len;
+  char *key;  // a cache miss, which comes back with its text to be cached
+  size_t keyLen;
+};
+
+// readline's callback interface has nowhere to pass these along
+static struct State *session;
+static bool ended = false;
+static char *previewed = NULL;  // the line the preview was made for
+static bool previewShown = false;
+static volatile sig_atomic_t cleared = 0;  // ctrl-c while typing
+
+static struct Output *newOutput(struct State *state, int kind) {
+  struct Output *o = calloc(1, sizeof(struct Output));
+  o->kind = kind;
+  o->format = state->format;
+  return o;
+}
+
+static void freeOutput(struct Output *o) {
+  if (o->kind == OutResult && !o->error) {
+    valueClear(&o->value);
   }
+  free(o->error);
+  free(o->text);
+  free(o->key);
+  free(o);
 }
 
-static void printValue(struct Value val, struct State *state) {
-  const char *err = calcError();
+static void writeResult(bool wireOut, struct Value v, struct Format *format, const char *err) {
+  if (wireOut) {
+    if (err) {
+      wireWriteText(stdout, WireError, err, strlen(err));
+    } else {
+      wireWriteValue(stdout, v);
+    }
+    return;
+  }
   if (err) {
     fprintf(stderr, "error: %s\n", err);
     return;
   }
-  if (state->unicode) {
-    uint32_t v = 0;
-    if (val.isF) {  // truncate floats
-      v = mpf_get_ui(val.f);
-    } else {
-      v = mpz_get_ui(val.z);
-    }
-    uint8_t utf[5] = {0};
-    if (v < 0x80) {
-      utf[0] = v;
-    } else if (v < 0x800) {
-      utf[0] = 0xc0 | (v >> 6);
-      utf[1] = 0x80 | (v & 0x3f);
-    } else if (v < 0x10000) {
-      utf[0] = 0xe0 | (v >> 12);
-      utf[1] = 0x80 | ((v >> 6) & 0x3f);
-      utf[2] = 0x80 | (v & 0x3f);
+  if (!printValue(stdout, v, format)) {
+    fprintf(stderr, "error: %s\n", calcError());
+  }
+}
+
+static void printResult(struct State *state) {
+  const char *err = calcError();
+  if (state->wireOut && !err) {
+    calcSettle(&state->prev);  // the next process gets all of it
+  }
+  if (state->results) {
+    struct Output *o = newOutput(state, OutResult);
+    if (err) {
+      o->error = strdup(err);  // the calculator reuses its buffers
     } else {
-      utf[0] = 0xf0 | (v >> 18);
-      utf[1] = 0x80 | ((v >> 12) & 0x3f);
-      utf[2] = 0x80 | ((v >> 6) & 0x3f);
-      utf[3] = 0x80 | (v & 0x3f);
-    }
-    printf("'%s' ", utf);
-  }
-  if (val.isF) {
-    mp_exp_t exp;
-    char *s = mpf_get_str(NULL, &exp, state->base, 0, val.f);
-    int len = strlen(s);
-    char *p = s;
-    if (*p == '-') {
-      fputc('-', stdout);
-      p++;
-      len--;
-    }
-    printBase(state->base);
-    if (exp == 0 && len == 0) {
-      fputc('0', stdout);
-    }
-    if (exp - len > 8 || exp - len < -8) {
-      fputc(*p++, stdout);
-      len--;
-      exp--;
-      fputc('.', stdout);
-      fwrite(p, 1, len, stdout);
-      if (exp) {
-        fprintf(stdout, "e%ld", exp);
-      }
-    } else if (exp < 0) {
-      fwrite("0.", 1, 2, stdout);
-      while (exp++ < 0) {
-        fputc('0', stdout);
-      }
-      fwrite(p, 1, len, stdout);
+      valueSet(&o->value, state->prev);
+    }
+    queuePush(state->results, o);
+    return;
+  }
+  writeResult(state->wireOut, state->prev, &state->format, err);
+}
+
+// prints $ without summarizing it
+static void printFull(struct State *state) {
+  if (state->wireOut) {
+    calcSettle(&state->prev);
+  }
+  if (state->results) {
+    struct Output *o = newOutput(state, OutResult);
+    o->format.summary = 0;
+    valueSet(&o->value, state->prev);
+    queuePush(state->results, o);
+    return;
+  }
+  struct Format format = state->format;
+  format.summary = 0;
+  calcStartClock();
+  writeResult(state->wireOut, state->prev, &format, NULL);
+}
+
+// errors from commands rather than calculations
+static void report(struct State *state, const char *err) {
+  if (state->results) {
+    struct Output *o = newOutput(state, OutError);
+    o->error = strdup(err);
+    queuePush(state->results, o);
+    return;
+  }
+  fprintf(stderr, "error: %s\n", err);
+}
+
+// the result becomes $ and joins the history
+static void evaluate(struct State *state, const char *expression) {
+  state->prev = calculate(expression, state->prev);
+  if (!calcError()) {
+    calcRemember(state->prev);
+  }
+  printResult(state);
+}
+
+// "=mod N" reduces integer results mod N, "=mod" on its own turns that off
+static void setModulus(struct State *state, const char *expression) {
+  while (isspace(*expression)) {
+    expression++;
+  }
+  calcSetModulus(NULL);
+  state->modEpoch++;
+  if (!*expression) {
+    return;
+  }
+  struct Value n;
+  valueSet(&n, state->prev);
+  n = calculate(expression, n);
+  const char *err = calcError();
+  long bits = 0;
+  if (n.isF) {
+    mpf_get_d_2exp(&bits, n.f);
+  }
+  if (err) {
+    report(state, err);
+  } else if (bits > MAX_MODULUS_BITS) {
+    report(state, "Too big");
+  } else {
+    valueToZ(&n);
+    if (mpz_sgn(n.z) <= 0) {
+      report(state, "Modulus must be positive");
     } else {
-      int out = exp;
-      if (out > len) {
-        out = len;
+      calcSetModulus(n.z);
+    }
+  }
+  valueClear(&n);
+}
+
+// the output state followed by the line with its whitespace collapsed outside quotes
+static char *cacheKey(struct State *state, const char *line, size_t *keyLen) {
+  char *key = malloc(strlen(line) + 64);
+  char *p = key + sprintf(key, "%d %d %d%c %d %u %u|", state->format.base, state->format.unicode,
+                          state->format.width, state->widthSigned ? 'i' : 'u',
+                          state->format.digits, state->modEpoch, calcGeneration());
+  while (isspace(*line)) {
+    line++;
+  }
+  while (*line) {
+    if (isspace(*line)) {
+      while (isspace(*line)) {
+        line++;
       }
-      fwrite(p, 1, out, stdout);
-      p += exp;
-      len -= exp;
-      while (len < 0) {
-        fputc('0', stdout);
-        len++;
+      if (*line) {
+        *p++ = ' ';
       }
-      fputc('.', stdout);
-      if (len > 0) {
-        fwrite(p, 1, len, stdout);
+    } else if (*line == '\'' || *line == '"') {
+      char quote = *line;
+      *p++ = *line++;
+      while (*line && *line != quote) {
+        if (*line == '\\' && line[1]) {
+          *p++ = *line++;
+        }
+        *p++ = *line++;
       }
+    } else {
+      *p++ = *line++;
+    }
+  }
+  *keyLen = p - key;
+  return key;
+}
+
+// cache misses the formatter thread has finished with join the cache
+static void settle(struct State *state) {
+  void *item;
+  while (state->formatted && queueTryPop(state->formatted, &item)) {
+    struct Output *o = item;
+    cacheInsert(state->cache, o->key, o->keyLen, o->value, o->text, o->len);
+    freeOutput(o);
+  }
+}
+
+// lines without $ or = depend only on the line, the registers and the output state
+static void handleCached(struct State *state, const char *line) {
+  settle(state);
+  size_t keyLen;
+  char *key = cacheKey(state, line, &keyLen);
+  struct Value v;
+  const char *output;
+  size_t outputLen;
+  if (cacheFind(state->cache, key, keyLen, &v, &output, &outputLen)) {
+    valueClear(&state->prev);
+    state->prev = v;
+    calcRemember(state->prev);
+    if (state->results) {
+      struct Output *o = newOutput(state, OutText);
+      o->text = malloc(outputLen);
+      memcpy(o->text, output, outputLen);
+      o->len = outputLen;
+      queuePush(state->results, o);
+    } else {
+      fwrite(output, 1, outputLen, stdout);
     }
-    free(s);
   } else {
-    char *s = mpz_get_str(NULL, state->base, val.z);
-    int len = strlen(s);
-    char *p = s;
-    if (*p == '-') {
-      fputc('-', stdout);
-      p++;
-      len--;
+    state->prev = calculate(line, state->prev);
+    const char *err = calcError();
+    // the cache hands its values back as $, which needs more than a double's worth
+    bool cacheable = !calcPartial(state->prev);
+    if (err) {
+      report(state, err);
+    } else if (state->results) {
+      calcRemember(state->prev);
+      struct Output *o = newOutput(state, OutResult);
+      valueSet(&o->value, state->prev);
+      if (cacheable) {
+        o->key = key;
+        o->keyLen = keyLen;
+        queuePush(state->results, o);
+        return;
+      }
+      queuePush(state->results, o);
+    } else {
+      calcRemember(state->prev);
+      char *buf = NULL;
+      size_t len = 0;
+      FILE *mem = open_memstream(&buf, &len);
+      bool printed = printValue(mem, state->prev, &state->format);
+      fclose(mem);
+      if (printed) {
+        fwrite(buf, 1, len, stdout);
+        if (cacheable) {
+          cacheInsert(state->cache, key, keyLen, state->prev, buf, len);
+        }
+      } else {
+        fprintf(stderr, "error: %s\n", calcError());
+      }
+      free(buf);
     }
-    printBase(state->base);
-    fwrite(p, 1, len, stdout);
-    free(s);
   }
-  fputc('\n', stdout);
+  free(key);
 }
 
 bool handleLine(struct State *state, char *line) {
@@ -161,53 +339,504 @@ bool handleLine(struct State *state, char *line) {
     start++;
   }
   if (*start == '?' || !memcmp(start, "help", 4)) {
-    printHelp();
+    if (state->results) {
+      queuePush(state->results, newOutput(state, OutHelp));
+    } else {
+      printHelp();
+    }
+    return true;
+  }
+  if (!memcmp(start, "full", 4)) {
+    printFull(state);
+    return true;
+  }
+  if (!memcmp(start, "=mod", 4)) {
+    setModulus(state, start + 4);
+    return true;
+  }
+  if (!memcmp(start, "=int", 4)) {
+    state->format.width = 0;
+    calcSetWidth(0, false);
+    return true;
+  }
+  if (!memcmp(start, "=digits", 7)) {
+    int n = atoi(start + 7);
+    if (calcSetDigits(n, state->format.base)) {
+      state->format.digits = n;
+    } else {
+      report(state, "Digits must be 0 to 1000000");
+    }
+    return true;
+  }
+  if (*start == '=' && (start[1] == 'i' || start[1] == 'u') && isdigit(start[2])) {
+    int bits = atoi(start + 2);
+    if (calcSetWidth(bits, start[1] == 'i')) {
+      state->format.width = bits;
+      state->widthSigned = start[1] == 'i';
+    } else {
+      report(state, "Unknown width");
+    }
     return true;
   }
   if (*start == '=') {
-    state->base = 10;
-    state->unicode = false;
+    state->format.base = 10;
+    state->format.unicode = false;
     switch (start[1]) {
       case 'b':
-        state->base = 2;
+        state->format.base = 2;
         break;
       case 'o':
-        state->base = 8;
+        state->format.base = 8;
         break;
       case 'h':
-        state->base = 16;
+        state->format.base = 16;
         break;
       case 'u':
-        state->unicode = true;
+        state->format.unicode = true;
         break;
     }
+    calcSetDigits(state->format.digits, state->format.base);
     return true;
   }
   if (!memcmp(start, "quit", 4) || !memcmp(start, "exit", 4)) {
     return false;
   }
-  state->prev = calculate(line, state->prev);
-  printValue(state->prev, state);
+  if (state->cache && !state->wireOut && !strpbrk(line, "$=")) {
+    handleCached(state, line);
+    return true;
+  }
+  evaluate(state, line);
   return true;
 }
 
+// number records become $ and expression is evaluated for each, expression records are
+// evaluated like lines
+static void handleWire(struct State *state, const char *expression) {
+  struct Value v;
+  valueInitZ(&v);
+  char *text;
+  int kind;
+  // parsed once for all the number records, until a line changes a mode or register
+  struct Expression *compiled = NULL;
+  bool stale = true;
+  unsigned generation = 0;
+  while ((kind = wireRead(stdin, &v, &text)) != WireEnd) {
+    switch (kind) {
+      case WireInt:
+      case WireFloat:
+        {
+          struct Value old = state->prev;
+          state->prev = v;
+          v = old;
+        }
+        if (stale || generation != calcGeneration()) {
+          if (compiled) {
+            calcFree(compiled);
+          }
+          compiled = calcCompileLine(expression);
+          generation = calcGeneration();
+          stale = false;
+        }
+        if (compiled) {
+          state->prev = calcEvalLine(compiled, state->prev);
+          if (!calcError()) {
+            calcRemember(state->prev);
+          }
+          printResult(state);
+        } else {
+          evaluate(state, expression);
+        }
+        break;
+      case WireExpression:
+        handleLine(state, text);
+        free(text);
+        stale = true;
+        break;
+      case WireError:  // pass upstream errors along
+        if (state->wireOut) {
+          wireWriteText(stdout, WireError, text, strlen(text));
+        } else {
+          fprintf(stderr, "error: %s\n", text);
+        }
+        free(text);
+        break;
+    }
+  }
+  if (compiled) {
+    calcFree(compiled);
+  }
+  valueClear(&v);
+}
+
+// bytes, with an optional K, M or G suffix
+static size_t parseSize(const char *arg) {
+  char *end;
+  size_t size = strtoull(arg, &end, 10);
+  switch (toupper(*end)) {
+    case 'G':
+      size <<= 10;
+      // fall through
+    case 'M':
+      size <<= 10;
+      // fall through
+    case 'K':
+      size <<= 10;
+      break;
+  }
+  return size;
+}
+
+// ctrl-c stops the calculation in progress, or asks for the line being typed to be cleared
+static void onInterrupt(int sig) {
+  (void)sig;
+  if (busy) {
+    calcInterrupt();
+  } else {
+    cleared = 1;
+  }
+}
+
+/**
+ * Readline calls this when a signal interrupts its wait for a key.  It's
+ * where the line is cleared after ctrl-c, since none of this is safe from
+ * the signal handler itself.
+ */
+static int onSignal() {
+  if (!cleared) {
+    return 0;
+  }
+  cleared = 0;
+  // the new prompt goes where the preview was
+  fputs(previewShown ? "\n\033[J" : "\n", stdout);
+  previewShown = false;
+  rl_replace_line("", 0);
+  rl_on_new_line();
+  rl_redisplay();
+  return 0;
+}
+
+static char *nextLine(const char *prompt) {
+  if (prompt) {
+    char *line = readline(prompt);
+    if (line) {
+      add_history(line);
+    }
+    return line;
+  }
+  // readline echoes its input when stdin isn't a terminal, which would
+  // end up mixed in with our results
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len = getline(&line, &cap, stdin);
+  if (len < 0) {
+    free(line);
+    return NULL;
+  }
+  if (len > 0 && line[len - 1] == '\n') {
+    line[len - 1] = 0;
+  }
+  return line;
+}
+
+// the first stage of the pipeline, splits stdin into lines
+static void *readLines(void *arg) {
+  struct Queue *lines = arg;
+  char *line;
+  while ((line = nextLine(NULL)) != NULL) {
+    queuePush(lines, line);
+  }
+  queuePush(lines, NULL);
+  return NULL;
+}
+
+// the last stage, writes the output of each line in order
+static void *writeOutputs(void *arg) {
+  struct State *state = arg;
+  struct Output *o;
+  while ((o = queuePop(state->results)) != NULL) {
+    switch (o->kind) {
+      case OutResult:
+        if (o->key) {  // formatted the same way handleCached() does it
+          FILE *mem = open_memstream(&o->text, &o->len);
+          bool printed = printValue(mem, o->value, &o->format);
+          fclose(mem);
+          if (printed) {
+            fwrite(o->text, 1, o->len, stdout);
+            queuePush(state->formatted, o);
+            continue;
+          }
+          fprintf(stderr, "error: %s\n", calcError());
+        } else {
+          writeResult(state->wireOut, o->value, &o->format, o->error);
+        }
+        break;
+      case OutError:
+        fprintf(stderr, "error: %s\n", o->error);
+        break;
+      case OutText:
+        fwrite(o->text, 1, o->len, stdout);
+        break;
+      case OutHelp:
+        printHelp();
+        break;
+    }
+    freeOutput(o);
+  }
+  return NULL;
+}
+
+/**
+ * Reads, evaluates and writes lines on three threads, so reading the next
+ * line and printing the last result overlap with evaluating this one.
+ * Evaluating stays on this thread, in order, since any line can use $ and
+ * the registers the lines before it set.
+ */
+static void runPipeline(struct State *state) {
+  struct Queue *lines = queueCreate(PIPELINE_DEPTH);
+  state->results = queueCreate(PIPELINE_DEPTH);
+  // roomy enough for every cache miss in flight, so the writer never waits on it
+  state->formatted = queueCreate(PIPELINE_DEPTH * 4);
+  pthread_t reader, writer;
+  pthread_create(&reader, NULL, readLines, lines);
+  pthread_create(&writer, NULL, writeOutputs, state);
+  bool more = true;
+  char *line;
+  while (more && (line = queuePop(lines)) != NULL) {
+    more = handleLine(state, line);
+    free(line);
+  }
+  queuePush(state->results, NULL);
+  pthread_join(writer, NULL);
+  settle(state);
+  queueFree(state->results);
+  queueFree(state->formatted);
+  state->results = NULL;
+  state->formatted = NULL;
+  if (more) {
+    pthread_join(reader, NULL);
+    queueFree(lines);
+  } else {
+    pthread_detach(reader);  // it may be waiting on stdin, and goes with the process
+  }
+}
+
+// lines that are commands rather than expressions
+static bool isCommand(const char *line) {
+  while (*line && (isspace(*line) || *line == '-')) {
+    line++;
+  }
+  return *line == '=' || *line == '?' || !strncmp(line, "help", 4) || !strncmp(line, "full", 4) ||
+    !strncmp(line, "quit", 4) || !strncmp(line, "exit", 4);
+}
+
+/**
+ * The result of the line so far, formatted the way Enter would show it, or
+ * NULL if there isn't one.  Nothing is remembered or assigned.
+ */
+static char *previewText(struct State *state, const char *line) {
+  if (isCommand(line)) {
+    return NULL;
+  }
+  struct Value prev;
+  calcCopy(&prev, state->prev);  // so reading $ works out all of it
+  calcSetTimeLimit(PREVIEW_SECONDS);
+  calcStopOnInput(fileno(rl_instream ? rl_instream : stdin));  // the next key makes it stale
+  struct Value v = calcPreview(line, prev);
+  char *text = NULL;
+  if (!calcError()) {
+    size_t len;
+    FILE *mem = open_memstream(&text, &len);
+    bool printed = printValue(mem, v, &state->format);
+    fclose(mem);
+    if (!printed) {
+      free(text);
+      text = NULL;
+    }
+  }
+  calcStopOnInput(-1);
+  calcSetTimeLimit(state->timeout);
+  valueClear(&v);
+  return text;
+}
+
+// terminal columns taken by the first n bytes of s
+static int columns(const char *s, int n) {
+  int cols = 0;
+  for (int i = 0; i < n; i++) {
+    if ((s[i] & 0xc0) != 0x80) {
+      cols++;
+    }
+  }
+  return cols;
+}
+
+/**
+ * Shows text dimmed on the row below the input, or clears that row when
+ * text is NULL, then puts the cursor back where readline left it.
+ */
+static void drawPreview(const char *text) {
+  int rows, cols;
+  rl_get_screen_size(&rows, &cols);
+  if (cols < 4) {
+    return;
+  }
+  int prompt = columns(rl_prompt, strlen(rl_prompt));
+  int cursor = prompt + columns(rl_line_buffer, rl_point);
+  int last = (prompt + columns(rl_line_buffer, rl_end)) / cols;
+  int down = last - cursor / cols + 1;
+  if (down > 1) {
+    printf("\033[%dB", down - 1);
+  }
+  printf("\r\n\033[J");
+  if (text) {
+    // cut to one row, before the first character that doesn't fit
+    int n = 0;
+    for (int shown = 0; text[n] && text[n] != '\n'; n++) {
+      if ((text[n] & 0xc0) != 0x80 && shown++ == cols - 3) {
+        break;
+      }
+    }
+    printf("\033[2m= %.*s\033[0m", n, text);
+  }
+  printf("\033[%dA\r", down);
+  if (cursor % cols) {
+    printf("\033[%dC", cursor % cols);
+  }
+  fflush(stdout);
+  previewShown = text != NULL;
+}
+
+static bool keysWaiting() {
+  struct pollfd pending = {fileno(rl_instream ? rl_instream : stdin), POLLIN, 0};
+  return poll(&pending, 1, 0) > 0;
+}
+
+/**
+ * Previews the line if it changed, unless more keys are already waiting.
+ * A key pressed while it's worked out stops it, and the next one is tried
+ * once that key is read.
+ */
+static void updatePreview(struct State *state) {
+  if ((previewed && !strcmp(previewed, rl_line_buffer)) || keysWaiting()) {
+    return;
+  }
+  char *text = previewText(state, rl_line_buffer);
+  if (keysWaiting()) {
+    free(text);
+    return;
+  }
+  if (text || previewShown) {
+    drawPreview(text);
+  }
+  free(text);
+  free(previewed);
+  previewed = strdup(rl_line_buffer);
+}
+
+static void onLine(char *line) {
+  if (previewShown) {  // readline leaves the cursor on the preview row
+    fputs("\033[J", stdout);
+    previewShown = false;
+  }
+  free(previewed);
+  previewed = NULL;
+  ended = !line;
+  if (line) {
+    add_history(line);
+    busy = 1;
+    ended = !handleLine(session, line);
+    busy = 0;
+    free(line);
+  }
+  if (ended) {  // before readline shows another prompt
+    rl_callback_handler_remove();
+  }
+}
+
 int main(int argc, char **argv) {
   struct State state;
-  state.unicode = false;
-  state.base = 10;
-  mpf_init(state.prev.f);
-  mpz_init(state.prev.z);
-  state.prev.isF = false;
-  
+  state.format.unicode = false;
+  state.format.base = 10;
+  state.wireOut = false;
+  state.format.width = 0;
+  state.format.digits = 0;
+  state.format.summary = 0;
+  state.modEpoch = 0;
+  state.widthSigned = false;
+  state.cache = NULL;
+  state.timeout = 0;
+  state.results = NULL;
+  state.formatted = NULL;
+  valueInitZ(&state.prev);
+
+  if (argc > 1 && !strcmp(argv[1], "--convert")) {
+    int from, to;
+    if (argc != 3 || !parseConvertSpec(argv[2], &from, &to)) {
+      fprintf(stderr, "usage: zx --convert FROM:TO  (bases are d, h, o, b)\n");
+      return 1;
+    }
+    return convertStream(stdin, stdout, from, to) ? 0 : 1;
+  }
+  if (argc > 1 && (!strcmp(argv[1], "--csv") || !strcmp(argv[1], "--tsv"))) {
+    if (argc != 3) {
+      fprintf(stderr, "usage: zx %s 'EXPR'  ($1, $2... are columns)\n", argv[1]);
+      return 1;
+    }
+    char delimiter = argv[1][2] == 'c' ? ',' : '\t';
+    return runCsv(stdin, stdout, argv[2], delimiter, &state.format) ? 0 : 1;
+  }
+
+  int first = 1;
+  bool wireIn = false;
+  bool stats = false;
+  bool preview = true;
+  bool pipelined = false;
+  size_t cacheSize = 16 << 20;
+  const char *storePath = NULL;
+  size_t storeSize = 256 << 20;
+  for (; first < argc; first++) {
+    if (!strcmp(argv[first], "--wire-in")) {
+      wireIn = true;
+    } else if (!strcmp(argv[first], "--wire-out")) {
+      state.wireOut = true;
+    } else if (!strcmp(argv[first], "--stats")) {
+      stats = true;
+    } else if (!strcmp(argv[first], "--cache-size") && first + 1 < argc) {
+      cacheSize = parseSize(argv[++first]);
+    } else if (!strcmp(argv[first], "--disk-cache") && first + 1 < argc) {
+      storePath = argv[++first];
+    } else if (!strcmp(argv[first], "--disk-cache-size") && first + 1 < argc) {
+      storeSize = parseSize(argv[++first]);
+    } else if (!strcmp(argv[first], "--timeout") && first + 1 < argc) {
+      state.timeout = atof(argv[++first]);
+      calcSetTimeLimit(state.timeout);
+    } else if (!strcmp(argv[first], "--no-preview")) {
+      preview = false;
+    } else if (!strcmp(argv[first], "--pipeline")) {
+      pipelined = true;
+    } else {
+      break;
+    }
+  }
+  struct Store *store = NULL;
+  if (storePath) {
+    store = storeOpen(storePath, storeSize);
+    if (!store) {
+      fprintf(stderr, "error: Can't use %s as a disk cache\n", storePath);
+      return 1;
+    }
+    calcSetStore(store);
+  }
+
   // if we have args, join them together as a single input
-  if (argc > 1) {
+  if (argc > first) {
     int len = 1;  // include eos
-    for (int i = 1; i < argc; i++) {
+    for (int i = first; i < argc; i++) {
       len += strlen(argv[i]) + 1;  // arg + space
     }
     char *line = calloc(len, 1);
     int pos = 0;
-    for (int i = 1; i < argc; i++) {
+    for (int i = first; i < argc; i++) {
       int l = strlen(argv[i]);
       memcpy(line + pos, argv[i], l);
       pos += l;
@@ -215,8 +844,14 @@ int main(int argc, char **argv) {
         line[pos++] = ' ';
       }
     }
-    handleLine(&state, line);
+    if (wireIn) {
+      handleWire(&state, line);
+    } else {
+      handleLine(&state, line);
+    }
     free(line);
+  } else if (wireIn) {
+    handleWire(&state, "$");  // each number record is printed as it is
   } else {
     const char *prompt = NULL;
     // no args, so keep reading lines from stdin
@@ -224,16 +859,59 @@ int main(int argc, char **argv) {
       // we print a header if we're not piping
       fprintf(stdout, "zx version %s\n© Copyright 2025 Sean Kasun\nType \"quit\" to quit\n", VERSION);
       prompt = ": ";
+      state.format.summary = SUMMARY_DIGITS;
     }
     char *line = NULL;
-    using_history();
-    while ((line = readline(prompt)) != NULL) {
-      add_history(line);
-      if (!handleLine(&state, line)) {
-        break;
+    if (prompt) {
+      using_history();
+      stifle_history(HISTORY_LINES);
+      struct sigaction action = {0};
+      action.sa_handler = onInterrupt;
+      sigemptyset(&action.sa_mask);
+      sigaction(SIGINT, &action, NULL);
+      rl_signal_event_hook = onSignal;
+    } else if (cacheSize) {
+      state.cache = cacheCreate(cacheSize);
+    }
+    if (prompt && preview && strcmp(getenv("TERM") ? getenv("TERM") : "dumb", "dumb")) {
+      // read a key at a time, so the result can be shown while typing
+      session = &state;
+      rl_callback_handler_install(prompt, onLine);
+      while (!ended) {
+        rl_callback_read_char();
+        if (!ended) {
+          updatePreview(&state);
+          onSignal();  // ctrl-c while the preview was being worked out
+        }
       }
+    }
+    // printing counts against the time limit, and one CPU can only run one stage at a time
+    if (!prompt && pipelined && !state.timeout && sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+      runPipeline(&state);
+      ended = true;
+    }
+    while (!ended && (line = nextLine(prompt)) != NULL) {
+      busy = 1;
+      bool more = handleLine(&state, line);
+      busy = 0;
       free(line);
+      if (!more) {
+        break;
+      }
+    }
+    if (state.cache) {
+      if (stats) {
+        cacheStats(state.cache, stderr);
+      }
+      cacheFree(state.cache);
+    }
+  }
+  if (store) {
+    if (stats) {
+      storeStats(store, stderr);
     }
+    storeClose(store);
   }
+  valueClear(&state.prev);
   return 0;
 }
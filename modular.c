@@ -0,0 +1,167 @@
+/** @copyright 2025 Sean Kasun */
+#include "modular.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__SIZEOF_INT128__) && ULONG_MAX == UINT64_MAX
+#define WORD_PATH 1
+typedef unsigned __int128 u128;
+#endif
+
+/**
+ * Everything that can be worked out once per modulus.  Moduli that fit in a
+ * machine word are reduced natively, with Montgomery form used for powers of
+ * odd moduli.  Larger moduli use Barrett reduction for products.
+ */
+struct ModContext {
+  mpz_t n;
+  mpz_t mu;  // floor(4^k / n)
+  mpz_t q;
+  mp_bitcnt_t k;
+  bool word;
+  uint64_t n64;
+  uint64_t ninv;  // -n^-1 mod 2^64
+  uint64_t r2;  // 2^128 mod n
+};
+
+struct ModContext *modCreate(mpz_srcptr n) {
+  struct ModContext *ctx = malloc(sizeof(struct ModContext));
+  mpz_init_set(ctx->n, n);
+  mpz_init(ctx->mu);
+  mpz_init(ctx->q);
+  ctx->k = mpz_sizeinbase(n, 2);
+  ctx->word = false;
+#ifdef WORD_PATH
+  if (ctx->k <= 64) {
+    ctx->word = true;
+    ctx->n64 = mpz_get_ui(n);
+    if (ctx->n64 & 1) {
+      uint64_t inv = ctx->n64;  // newton's method, each step doubles the bits
+      for (int i = 0; i < 5; i++) {
+        inv *= 2 - ctx->n64 * inv;
+      }
+      ctx->ninv = -inv;
+      uint64_t r = (0 - ctx->n64) % ctx->n64;
+      ctx->r2 = (u128)r * r % ctx->n64;
+    }
+    return ctx;
+  }
+#endif
+  mpz_setbit(ctx->mu, 2 * ctx->k);
+  mpz_tdiv_q(ctx->mu, ctx->mu, n);
+  return ctx;
+}
+
+void modFree(struct ModContext *ctx) {
+  mpz_clear(ctx->n);
+  mpz_clear(ctx->mu);
+  mpz_clear(ctx->q);
+  free(ctx);
+}
+
+// leaves a in [0, n)
+void modReduce(struct ModContext *ctx, mpz_ptr a) {
+#ifdef WORD_PATH
+  if (ctx->word) {
+    mpz_set_ui(a, mpz_fdiv_ui(a, ctx->n64));
+    return;
+  }
+#endif
+  if (mpz_sgn(a) < 0 || mpz_cmp(a, ctx->n) >= 0) {
+    mpz_mod(a, a, ctx->n);
+  }
+}
+
+// a must be in [0, n^2)
+static void barrett(struct ModContext *ctx, mpz_ptr a) {
+  mpz_tdiv_q_2exp(ctx->q, a, ctx->k - 1);
+  mpz_mul(ctx->q, ctx->q, ctx->mu);
+  mpz_tdiv_q_2exp(ctx->q, ctx->q, ctx->k + 1);
+  mpz_submul(a, ctx->q, ctx->n);
+  while (mpz_cmp(a, ctx->n) >= 0) {
+    mpz_sub(a, a, ctx->n);
+  }
+}
+
+#ifdef WORD_PATH
+static inline uint64_t redc(struct ModContext *ctx, u128 t) {
+  uint64_t m = (uint64_t)t * ctx->ninv;
+  u128 mn = (u128)m * ctx->n64;
+  // the low halves cancel, so they only carry when t's is nonzero
+  u128 r = (t >> 64) + (mn >> 64) + ((uint64_t)t != 0);
+  if (r >= ctx->n64) {
+    r -= ctx->n64;
+  }
+  return r;
+}
+
+static uint64_t powWord(struct ModContext *ctx, uint64_t b, mpz_srcptr e) {
+  size_t bits = mpz_sizeinbase(e, 2);
+  if (ctx->n64 & 1) {
+    uint64_t x = redc(ctx, (u128)b * ctx->r2);
+    uint64_t r = redc(ctx, ctx->r2);  // 1 in montgomery form
+    for (size_t i = bits; i-- > 0;) {
+      r = redc(ctx, (u128)r * r);
+      if (mpz_tstbit(e, i)) {
+        r = redc(ctx, (u128)r * x);
+      }
+    }
+    return redc(ctx, r);
+  }
+  uint64_t r = 1 % ctx->n64;
+  for (size_t i = bits; i-- > 0;) {
+    r = (u128)r * r % ctx->n64;
+    if (mpz_tstbit(e, i)) {
+      r = (u128)r * b % ctx->n64;
+    }
+  }
+  return r;
+}
+#endif
+
+// a = a * b mod n, b may be reduced in place
+void modMul(struct ModContext *ctx, mpz_ptr a, mpz_ptr b) {
+#ifdef WORD_PATH
+  if (ctx->word) {
+    uint64_t x = mpz_fdiv_ui(a, ctx->n64);
+    uint64_t y = mpz_fdiv_ui(b, ctx->n64);
+    mpz_set_ui(a, (u128)x * y % ctx->n64);
+    return;
+  }
+#endif
+  modReduce(ctx, a);
+  modReduce(ctx, b);
+  mpz_mul(a, a, b);
+  barrett(ctx, a);
+}
+
+// a = a ** e mod n, negative powers need a to be invertible
+bool modPow(struct ModContext *ctx, mpz_ptr a, mpz_ptr e) {
+  if (mpz_sgn(e) < 0) {
+    if (!mpz_invert(a, a, ctx->n)) {
+      return false;
+    }
+    mpz_neg(e, e);
+  }
+#ifdef WORD_PATH
+  if (ctx->word) {
+    mpz_set_ui(a, powWord(ctx, mpz_fdiv_ui(a, ctx->n64), e));
+    return true;
+  }
+#endif
+  // gmp's powm already works in montgomery form for odd moduli
+  mpz_powm(a, a, e, ctx->n);
+  return true;
+}
+
+// a = a * 2^bits mod n, without ever building the full shifted value
+void modShl(struct ModContext *ctx, mpz_ptr a, mp_bitcnt_t bits) {
+  mpz_t t, e;
+  mpz_init_set_ui(t, 2);
+  mpz_init_set_ui(e, bits);
+  modPow(ctx, t, e);
+  modMul(ctx, a, t);
+  mpz_clear(t);
+  mpz_clear(e);
+}
@@ -0,0 +1,14 @@
+/** @copyright 2025 Sean Kasun */
+#pragma once
+
+#include <stdbool.h>
+#include <gmp.h>
+
+struct ModContext;
+
+extern struct ModContext *modCreate(mpz_srcptr n);
+extern void modFree(struct ModContext *ctx);
+extern void modReduce(struct ModContext *ctx, mpz_ptr a);
+extern void modMul(struct ModContext *ctx, mpz_ptr a, mpz_ptr b);
+extern bool modPow(struct ModContext *ctx, mpz_ptr a, mpz_ptr e);
+extern void modShl(struct ModContext *ctx, mpz_ptr a, mp_bitcnt_t bits);
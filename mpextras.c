@@ -1,8 +1,19 @@
 /** @copyright 2025 Sean Kasun */
 
 #include "mpextras.h"
+#include "bits.h"
 #include <gmp.h>
+#include <math.h>
 #include <mpfr.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// an mpf holds up to two limbs more than its precision, so this is exact
+static void initSet(mpfr_ptr r, mpf_srcptr op) {
+  mpfr_init2(r, mpf_get_prec(op) + 2 * GMP_NUMB_BITS);
+  mpfr_set_f(r, op, MPFR_RNDN);
+}
 
 // num - floor(num / den) * den
 void mpf_tdiv_r(mpf_ptr rem, mpf_srcptr num, mpf_srcptr den) {
@@ -15,26 +26,53 @@ void mpf_tdiv_r(mpf_ptr rem, mpf_srcptr num, mpf_srcptr den) {
   mpf_clear(tmp);
 }
 
-void mpf_pow(mpf_ptr result, mpf_srcptr base, mpf_srcptr exp) {
+// these return false when the result is NaN or infinite, leaving result as is
+bool mpf_pow(mpf_ptr result, mpf_srcptr base, mpf_srcptr exp) {
   mpfr_t b, e, r;
   mpfr_init2(r, mpf_get_prec(result));
-  mpfr_init_set_f(b, base, MPFR_RNDN);
-  mpfr_init_set_f(e, exp, MPFR_RNDN);
+  initSet(b, base);
+  initSet(e, exp);
 
   mpfr_pow(r, b, e, MPFR_RNDN);
 
-  mpfr_get_f(result, r, MPFR_RNDN);
+  bool finite = mpfr_number_p(r);
+  if (finite) {
+    mpfr_get_f(result, r, MPFR_RNDN);
+  }
 
   mpfr_clear(b);
   mpfr_clear(e);
   mpfr_clear(r);
+  return finite;
+}
+
+// correctly rounded like mpf_pow(), so the result is the same, only sooner
+bool mpf_pow_si(mpf_ptr result, mpf_srcptr base, long exp) {
+  mpfr_t b, r;
+  mpfr_init2(r, mpf_get_prec(result));
+  initSet(b, base);
+
+  if (exp == 2) {
+    mpfr_sqr(r, b, MPFR_RNDN);
+  } else {
+    mpfr_pow_si(r, b, exp, MPFR_RNDN);
+  }
+
+  bool finite = mpfr_number_p(r);
+  if (finite) {
+    mpfr_get_f(result, r, MPFR_RNDN);
+  }
+
+  mpfr_clear(b);
+  mpfr_clear(r);
+  return finite;
 }
 
 void mpf_sqrt(mpf_ptr result, mpf_srcptr op) {
   mpfr_t r;
   mpfr_t o;
   mpfr_init2(r, mpf_get_prec(result));
-  mpfr_init_set_f(o, op, MPFR_RNDN);
+  initSet(o, op);
 
   mpfr_sqrt(r, o, MPFR_RNDN);
   
@@ -44,53 +82,513 @@ void mpf_sqrt(mpf_ptr result, mpf_srcptr op) {
   mpfr_clear(r);
 }
 
-void mpf_cos(mpf_ptr result, mpf_srcptr op) {
+bool mpf_cos(mpf_ptr result, mpf_srcptr op) {
   mpfr_t r;
   mpfr_t o;
   mpfr_init2(r, mpf_get_prec(result));
-  mpfr_init_set_f(o, op, MPFR_RNDN);
+  initSet(o, op);
 
   mpfr_cos(r, o, MPFR_RNDN);
   
-  mpfr_get_f(result, r, MPFR_RNDN);
+  bool finite = mpfr_number_p(r);
+  if (finite) {
+    mpfr_get_f(result, r, MPFR_RNDN);
+  }
 
   mpfr_clear(o);
   mpfr_clear(r);
+  return finite;
 }
 
-void mpf_sin(mpf_ptr result, mpf_srcptr op) {
+bool mpf_sin(mpf_ptr result, mpf_srcptr op) {
   mpfr_t r;
   mpfr_t o;
   mpfr_init2(r, mpf_get_prec(result));
-  mpfr_init_set_f(o, op, MPFR_RNDN);
+  initSet(o, op);
 
   mpfr_sin(r, o, MPFR_RNDN);
   
-  mpfr_get_f(result, r, MPFR_RNDN);
+  bool finite = mpfr_number_p(r);
+  if (finite) {
+    mpfr_get_f(result, r, MPFR_RNDN);
+  }
 
   mpfr_clear(o);
   mpfr_clear(r);
+  return finite;
 }
 
-void mpf_tan(mpf_ptr result, mpf_srcptr op) {
+bool mpf_tan(mpf_ptr result, mpf_srcptr op) {
   mpfr_t r;
   mpfr_t o;
   mpfr_init2(r, mpf_get_prec(result));
-  mpfr_init_set_f(o, op, MPFR_RNDN);
+  initSet(o, op);
 
   mpfr_tan(r, o, MPFR_RNDN);
   
-  mpfr_get_f(result, r, MPFR_RNDN);
+  bool finite = mpfr_number_p(r);
+  if (finite) {
+    mpfr_get_f(result, r, MPFR_RNDN);
+  }
 
   mpfr_clear(o);
   mpfr_clear(r);
+  return finite;
 }
 
 void mpf_round(mpz_ptr result, mpf_srcptr op) {
   mpfr_t o;
-  mpfr_init_set_f(o, op, MPFR_RNDN);
+  initSet(o, op);
 
   mpfr_get_z(result, o, MPFR_RNDN);
 
   mpfr_clear(o);
 }
+
+void mpf_pi(mpf_ptr result) {
+  mpfr_t r;
+  mpfr_init2(r, mpf_get_prec(result));
+
+  mpfr_const_pi(r, MPFR_RNDN);
+
+  mpfr_get_f(result, r, MPFR_RNDN);
+
+  mpfr_clear(r);
+}
+
+// copies MPFR's digits without trailing zeros, and frees them
+static char *trimmed(char *digitStr, mp_exp_t *exp) {
+  size_t len = strlen(digitStr);
+  while (len > 0 && digitStr[len - 1] == '0') {
+    len--;
+  }
+  if (len == 1 && *digitStr == '-') {
+    len = 0;
+  }
+  if (len == 0) {
+    *exp = 0;
+  }
+  char *s = malloc(len + 1);
+  memcpy(s, digitStr, len);
+  s[len] = 0;
+  mpfr_free_str(digitStr);
+  return s;
+}
+
+// like mpf_get_str(), but correctly rounded to digits, without trailing zeros
+char *mpf_get_str_rounded(mp_exp_t *exp, int base, size_t digits, mpf_srcptr op) {
+  mpfr_t o;
+  initSet(o, op);
+  char *s = trimmed(mpfr_get_str(NULL, exp, base, digits, o, MPFR_RNDN), exp);
+  mpfr_clear(o);
+  return s;
+}
+
+#define GUARD_DIGITS 3  // past the most any value needs, so the last digit's error is tiny
+#define TAIL_DIGITS (GUARD_DIGITS + 3)  // half an ulp is less than this many digits' worth
+
+// what mpfr_get_str_ndigits() gives, without working it out in MPFR every time
+static size_t digitsFor(int base, long prec) {
+  int bits = __builtin_ctz(base);
+  if (base == 1 << bits) {
+    return 1 + (prec - 1 + bits - 1) / bits;
+  }
+  return 1 + (size_t)ceil(prec * (M_LN2 / log(base)));
+}
+
+static int digitValue(char c) {
+  return c <= '9' ? c - '0' : c - 'a' + 10;
+}
+
+/**
+ * A read-only mpf of op's mantissa copied into limbs, rounded to nearest
+ * at prec bits with ties to even.  Its precision is raised so that
+ * mpf_get_str() gives as many digits as are asked for, rather than stopping
+ * at what it thinks the precision needs.  limbs needs room for one limb
+ * more than op has.
+ */
+static void roundMantissa(mpf_ptr r, mp_limb_t *limbs, mpf_srcptr op, long prec) {
+  int size = abs(op->_mp_size);
+  long bits = (long)size * GMP_NUMB_BITS - __builtin_clzl(op->_mp_d[size - 1]);
+  long drop = bits > prec ? bits - prec : 0;
+  int skip = drop / GMP_NUMB_BITS, shift = drop % GMP_NUMB_BITS;
+  int n = size - skip;
+  memcpy(limbs, op->_mp_d + skip, n * sizeof(mp_limb_t));
+  r->_mp_exp = op->_mp_exp;
+  if (drop) {
+    // the dropped bits, highest first, decide which way it goes
+    mp_limb_t below = shift ? limbs[0] << (GMP_NUMB_BITS - shift) : op->_mp_d[skip - 1];
+    bool sticky = below << 1 != 0;
+    for (int i = 0; i < skip - !shift && !sticky; i++) {
+      sticky = op->_mp_d[i] != 0;
+    }
+    mp_limb_t one = (mp_limb_t)1 << shift;
+    limbs[0] &= -one;
+    if (below >> (GMP_NUMB_BITS - 1) && (sticky || (limbs[0] & one))) {
+      if (mpn_add_1(limbs, limbs, n, one)) {
+        limbs[n++] = 1;
+        r->_mp_exp++;
+      }
+    }
+  }
+  int low = 0;
+  while (!limbs[low]) {
+    low++;
+  }
+  r->_mp_d = limbs + low;
+  r->_mp_size = op->_mp_size < 0 ? low - n : n - low;
+  r->_mp_prec = op->_mp_prec + 3;
+}
+
+/**
+ * When op holds more bits than its precision and is a short decimal, sets
+ * digits to all of it.  Sums and products of short inputs end up like that,
+ * while results that were cut off run to the end of their limbs and would
+ * take far more digits than the precision needs.
+ */
+static bool heldExactly(char *digits, mp_exp_t *exp, int base, mpf_srcptr op) {
+  int bitsPerDigit = __builtin_ctz(base);
+  if (base != 10 && base != 1 << bitsPerDigit) {
+    return false;  // short binary fractions don't end in other bases
+  }
+  int size = abs(op->_mp_size);
+  int low = 0;
+  while (!op->_mp_d[low]) {
+    low++;
+  }
+  long top = (long)op->_mp_exp * GMP_NUMB_BITS - __builtin_clzl(op->_mp_d[size - 1]);
+  long bottom = (long)(op->_mp_exp - size + low) * GMP_NUMB_BITS + __builtin_ctzl(op->_mp_d[low]);
+  if (top - bottom <= (long)mpf_get_prec(op)) {
+    return false;  // the precision already shows it exactly
+  }
+  // op is below 10^lead, and its last decimal digit is in the place of 10^last
+  size_t most = digitsFor(10, mpf_get_prec(op)) + GUARD_DIGITS;
+  long last = bottom < 0 ? bottom : 0;
+  long lead = (long)floor((top - 1) * (M_LN2 / M_LN10)) + 2;
+  if (lead - 1 - last > (long)most) {
+    return false;
+  }
+  mpf_t all = {*op};
+  all->_mp_prec = op->_mp_prec + 3;
+  if (lead - last > (long)most || base == 10) {
+    // too close to tell without the digits
+    mpf_get_str(digits, exp, 10, most, all);
+    if (*exp - (long)most > last) {
+      return false;
+    }
+  }
+  if (base != 10) {
+    mpf_get_str(digits, exp, base, (top - bottom) / bitsPerDigit + 2, all);
+  }
+  return true;
+}
+
+// the first len digits of s, one more in the last place if up, carrying into *exp
+static void cut(char *out, const char *s, size_t len, bool up, int base, mp_exp_t *exp) {
+  size_t have = strlen(s);
+  for (size_t i = 0; i < len; i++) {
+    out[i] = i < have ? s[i] : '0';
+  }
+  out[len] = 0;
+  size_t i = len;
+  while (up && i > 0) {
+    i--;
+    up = digitValue(out[i]) == base - 1;
+    out[i] = up ? '0' : "0123456789abcdef"[digitValue(out[i]) + 1];
+  }
+  if (up) {
+    memmove(out + 1, out, len + 1);
+    out[0] = '1';
+    ++*exp;
+  }
+}
+
+// op rounded to n digits by MPFR, if those read back as op at prec, for when it's too close to call
+static char *readsBack(mp_exp_t *exp, int base, size_t n, mpf_srcptr op, mpfr_prec_t prec) {
+  mpfr_t x, y;
+  mpfr_init2(x, prec);
+  mpfr_init2(y, prec);
+  mpfr_set_f(x, op, MPFR_RNDN);
+  char *s = mpfr_get_str(NULL, exp, base, n, x, MPFR_RNDN);
+  // the digits are a fraction, so that's 0.digits times base to the exp
+  char *text = malloc(n + 32);
+  bool neg = *s == '-';
+  sprintf(text, "%s0.%s@%ld", neg ? "-" : "", s + neg, (long)*exp);
+  mpfr_strtofr(y, text, NULL, base, MPFR_RNDN);
+  if (!mpfr_equal_p(x, y)) {
+    mpfr_free_str(s);
+    s = NULL;
+  }
+  free(text);
+  mpfr_clear(x);
+  mpfr_clear(y);
+  return s;
+}
+
+/**
+ * Like mpf_get_str(), but only as many digits as it takes to read back as
+ * the same value at op's precision.  op is rounded to that precision and
+ * converted once, with a few digits more than any value needs.  Cutting
+ * those short moves them by an amount the last few digits give, which is
+ * compared with half the precision's last place to find the fewest that
+ * stay within it.  Only when the two are too close to call, or the digits
+ * are too close to halfway to tell which way to round, does MPFR round and
+ * read back.
+ */
+char *mpf_get_str_shortest(mp_exp_t *exp, int base, mpf_srcptr op) {
+  mpfr_prec_t prec = mpf_get_prec(op);
+  int size = abs(op->_mp_size);
+  size_t n = digitsFor(base, prec) + GUARD_DIGITS;
+  char *digits = malloc(2 * n);  // room for all of a value heldExactly() prints
+  if (!size) {
+    *exp = 0;
+    *digits = 0;
+    return digits;
+  }
+  if (heldExactly(digits, exp, base, op)) {
+    return digits;
+  }
+  mp_limb_t *limbs = malloc((size + 1) * sizeof(mp_limb_t));
+  mpf_t r;
+  roundMantissa(r, limbs, op, prec);
+  mpf_get_str(digits, exp, base, n, r);
+  // half of r's last place, counted in units of the last digit, which is less than one off
+  long e2 = (long)r->_mp_exp * GMP_NUMB_BITS - __builtin_clzl(r->_mp_d[abs(r->_mp_size) - 1]);
+  double half = exp2((e2 - prec - 1) - (*exp - (long)n) * log2(base));
+  double slack = half * (1e-9 + fabs((double)*exp) * 1e-14) + 1;
+  free(limbs);
+  bool neg = *digits == '-';
+  char *s = digits + neg;
+  size_t have = strlen(s);
+  long place[TAIL_DIGITS + 1] = {1};
+  for (int i = 1; i <= TAIL_DIGITS; i++) {
+    place[i] = place[i - 1] * base;
+  }
+  // the last few digits, and where the runs of zeros and of base - 1 before them start
+  long tail = 0;
+  for (size_t i = n - TAIL_DIGITS; i < n; i++) {
+    tail = tail * base + (i < have ? digitValue(s[i]) : 0);
+  }
+  size_t zeros = n - TAIL_DIGITS < have ? n - TAIL_DIGITS : have;
+  while (zeros > 0 && s[zeros - 1] == '0') {
+    zeros--;
+  }
+  size_t tops = n - TAIL_DIGITS;
+  while (tops > 0 && tops <= have && digitValue(s[tops - 1]) == base - 1) {
+    tops--;
+  }
+  // fewer digits than where those runs start can't be close enough
+  size_t len = zeros < tops ? zeros : tops;
+  len = len < n - TAIL_DIGITS ? len : n - TAIL_DIGITS;
+  len = len ? len : 1;
+  bool up = false;
+  for (; len < n; len++) {
+    // how far rounding down or up to len digits moves them, when it could be close enough
+    size_t k = n - len;
+    long down = -1, over = -1;
+    if (k <= TAIL_DIGITS) {
+      down = tail % place[k];
+      over = place[k] - down;
+    } else {
+      down = len >= zeros ? tail : -1;
+      over = len >= tops ? place[TAIL_DIGITS] - tail : -1;
+    }
+    up = down < 0 || (over >= 0 && over < down);
+    long dist = up ? over : down;
+    if (dist < 0 || dist - slack > half) {
+      continue;
+    }
+    bool tie = down >= 0 && over >= 0 && labs(down - over) <= 2;
+    if (!tie && dist + slack < half) {
+      break;
+    }
+    char *t = readsBack(exp, base, len, op, prec);
+    if (t) {
+      strcpy(digits, t);
+      mpfr_free_str(t);
+      len = 0;  // already there
+      break;
+    }
+  }
+  if (len) {
+    cut(s, s, len, len < n && up, base, exp);
+  }
+  // trailing zeros go, as mpf_get_str() drops them
+  size_t end = strlen(digits);
+  while (end > 0 && digits[end - 1] == '0') {
+    end--;
+  }
+  digits[end] = 0;
+  return digits;
+}
+
+#define LEADING_BITS 128  // far more than the digits need, so rarely too close to call
+
+/**
+ * Sets r * 2^returned to base^n rounded in the direction of rnd.  r is kept
+ * near 1, so a power past MPFR's exponent range needs no change to that
+ * range, which other threads may be relying on.
+ */
+static long scaledPow(mpfr_ptr r, int base, size_t n, mpfr_rnd_t rnd) {
+  long e = 0;
+  mpfr_set_ui(r, 1, rnd);
+  for (int bit = 8 * sizeof(n) - 1; bit >= 0; bit--) {
+    mpfr_sqr(r, r, rnd);
+    e *= 2;
+    if ((n >> bit) & 1) {
+      mpfr_mul_ui(r, r, base, rnd);
+    }
+    e += mpfr_get_exp(r);
+    mpfr_set_exp(r, 0);
+  }
+  return e;
+}
+
+/**
+ * Sets lead to the first n digits of |op| in base and *count to how many
+ * digits |op| has, working from its top bits rather than converting all
+ * of it.  Only when |op| is too close to a multiple of a power of base to
+ * tell that way is the power worked out exactly.  op must have more than n
+ * digits.
+ */
+void mpz_get_leading(mpz_ptr lead, size_t *count, int base, size_t n, mpz_srcptr op) {
+  // mpz_sizeinbase() can be one too many, so the quotient has n or n + 1 digits
+  size_t shift = mpz_sizeinbase(op, base) - n - 1;
+  long bits = mpz_sizeinbase(op, 2);
+  mpfr_t x, p, lo, hi;
+  mpfr_inits2(LEADING_BITS, x, p, lo, hi, (mpfr_ptr)0);
+  // lo rounds the quotient down and hi rounds it up, so the true one is between,
+  // with op scaled down by 2^bits and the power by 2^e to stay in range
+  mpfr_set_z_2exp(x, op, -bits, MPFR_RNDZ);
+  mpfr_abs(x, x, MPFR_RNDZ);
+  long e = scaledPow(p, base, shift, MPFR_RNDU);
+  mpfr_div(lo, x, p, MPFR_RNDD);
+  mpfr_mul_2si(lo, lo, bits - e, MPFR_RNDD);
+  mpfr_set_z_2exp(x, op, -bits, MPFR_RNDA);
+  mpfr_abs(x, x, MPFR_RNDA);
+  e = scaledPow(p, base, shift, MPFR_RNDD);
+  mpfr_div(hi, x, p, MPFR_RNDU);
+  mpfr_mul_2si(hi, hi, bits - e, MPFR_RNDU);
+  mpz_t q;
+  mpz_init(q);
+  mpfr_get_z(lead, lo, MPFR_RNDD);
+  mpfr_get_z(q, hi, MPFR_RNDD);
+  if (mpz_cmp(lead, q)) {
+    mpz_ui_pow_ui(q, base, shift);
+    mpz_tdiv_q(lead, op, q);
+    mpz_abs(lead, lead);
+  }
+  mpfr_clears(x, p, lo, hi, (mpfr_ptr)0);
+  mpz_ui_pow_ui(q, base, n);
+  *count = shift + n;
+  if (mpz_cmp(lead, q) >= 0) {
+    mpz_tdiv_q_ui(lead, lead, base);
+    (*count)++;
+  }
+  mpz_clear(q);
+}
+
+// op reversed over n limbs a limb at a time, op must fit in them
+static void reverseLimbs(mpz_ptr rop, mpz_srcptr op, size_t n, bool bytes) {
+  const mp_limb_t *src = mpz_limbs_read(op);
+  size_t size = mpz_size(op);
+  mpz_t t;
+  mpz_init2(t, n * GMP_NUMB_BITS);
+  mp_limb_t *dst = mpz_limbs_write(t, n);
+  for (size_t i = 0; i < n; i++) {
+    uint64_t x = i < size ? src[i] : 0;
+    x = bytes ? __builtin_bswap64(x) : bitsReverse(x);
+    dst[n - 1 - i] = x >> (64 - GMP_NUMB_BITS);
+  }
+  mpz_limbs_finish(t, n);
+  mpz_swap(rop, t);
+  mpz_clear(t);
+}
+
+// reverses the bits of op as n limbs, op must be non-negative and fit in them
+void mpz_bitrev(mpz_ptr rop, mpz_srcptr op, size_t n) {
+  reverseLimbs(rop, op, n, false);
+}
+
+// reverses the bytes of op as n limbs, op must be non-negative and fit in them
+void mpz_bswap(mpz_ptr rop, mpz_srcptr op, size_t n) {
+  reverseLimbs(rop, op, n, true);
+}
+
+// GMP_NUMB_BITS bits of x starting at bit pos, x is size limbs
+static uint64_t limbAt(const mp_limb_t *x, size_t size, mp_bitcnt_t pos) {
+  size_t i = pos / GMP_NUMB_BITS;
+  int shift = pos % GMP_NUMB_BITS;
+  uint64_t v = i < size ? x[i] >> shift : 0;
+  if (shift && i + 1 < size) {
+    v |= (uint64_t)x[i + 1] << (GMP_NUMB_BITS - shift);
+  }
+  return v & GMP_NUMB_MASK;
+}
+
+// op if it's non-negative, otherwise its low bits in two's complement
+static mpz_srcptr lowBits(mpz_ptr t, mpz_srcptr op, mp_bitcnt_t bits) {
+  if (mpz_sgn(op) >= 0) {
+    return op;
+  }
+  mpz_fdiv_r_2exp(t, op, bits);
+  return t;
+}
+
+/**
+ * Scatters the low bits of op, lowest first, to the set bits of mask, a
+ * limb at a time.  mask must be non-negative, op is taken in two's
+ * complement.
+ */
+void mpz_pdep(mpz_ptr rop, mpz_srcptr op, mpz_srcptr mask) {
+  size_t n = mpz_size(mask);
+  if (!n) {
+    mpz_set_ui(rop, 0);
+    return;
+  }
+  mpz_t t, r;
+  mpz_inits(t, r, NULL);
+  mpz_srcptr x = lowBits(t, op, mpz_popcount(mask));
+  const mp_limb_t *xs = mpz_limbs_read(x), *m = mpz_limbs_read(mask);
+  size_t size = mpz_size(x);
+  mp_limb_t *dst = mpz_limbs_write(r, n);
+  mp_bitcnt_t pos = 0;
+  for (size_t i = 0; i < n; i++) {
+    dst[i] = bitsDeposit(limbAt(xs, size, pos), m[i]);
+    pos += bitsCount(m[i]);
+  }
+  mpz_limbs_finish(r, n);
+  mpz_swap(rop, r);
+  mpz_clears(t, r, NULL);
+}
+
+/**
+ * Gathers the bits of op under the set bits of mask into the low bits, a
+ * limb at a time.  mask must be non-negative, op is taken in two's
+ * complement.
+ */
+void mpz_pext(mpz_ptr rop, mpz_srcptr op, mpz_srcptr mask) {
+  size_t n = mpz_size(mask);
+  size_t len = mpz_popcount(mask) / GMP_NUMB_BITS + 1;
+  mpz_t t, r;
+  mpz_inits(t, r, NULL);
+  mpz_srcptr x = lowBits(t, op, n * GMP_NUMB_BITS);
+  const mp_limb_t *xs = mpz_limbs_read(x), *m = mpz_limbs_read(mask);
+  size_t size = mpz_size(x);
+  mp_limb_t *dst = mpz_limbs_write(r, len);
+  memset(dst, 0, len * sizeof(mp_limb_t));
+  mp_bitcnt_t pos = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t bits = bitsExtract(i < size ? xs[i] : 0, m[i]);
+    size_t j = pos / GMP_NUMB_BITS;
+    int shift = pos % GMP_NUMB_BITS;
+    dst[j] |= (bits << shift) & GMP_NUMB_MASK;
+    if (shift && j + 1 < len) {
+      dst[j + 1] |= bits >> (GMP_NUMB_BITS - shift);
+    }
+    pos += bitsCount(m[i]);
+  }
+  mpz_limbs_finish(r, len);
+  mpz_swap(rop, r);
+  mpz_clears(t, r, NULL);
+}
@@ -2,11 +2,21 @@
 #pragma once
 
 #include <gmp.h>
+#include <stdbool.h>
 
 extern void mpf_tdiv_r(mpf_ptr rem, mpf_srcptr num, mpf_srcptr den);
-extern void mpf_pow(mpf_ptr result, mpf_srcptr base, mpf_srcptr exp);
+extern bool mpf_pow(mpf_ptr result, mpf_srcptr base, mpf_srcptr exp);
+extern bool mpf_pow_si(mpf_ptr result, mpf_srcptr base, long exp);
 extern void mpf_sqrt(mpf_ptr result, mpf_srcptr op);
-extern void mpf_cos(mpf_ptr result, mpf_srcptr op);
-extern void mpf_sin(mpf_ptr result, mpf_srcptr op);
-extern void mpf_tan(mpf_ptr result, mpf_srcptr op);
+extern bool mpf_cos(mpf_ptr result, mpf_srcptr op);
+extern bool mpf_sin(mpf_ptr result, mpf_srcptr op);
+extern bool mpf_tan(mpf_ptr result, mpf_srcptr op);
 extern void mpf_round(mpz_ptr result, mpf_srcptr op);
+extern void mpf_pi(mpf_ptr result);
+extern char *mpf_get_str_rounded(mp_exp_t *exp, int base, size_t digits, mpf_srcptr op);
+extern char *mpf_get_str_shortest(mp_exp_t *exp, int base, mpf_srcptr op);
+extern void mpz_get_leading(mpz_ptr lead, size_t *count, int base, size_t n, mpz_srcptr op);
+extern void mpz_bitrev(mpz_ptr rop, mpz_srcptr op, size_t n);
+extern void mpz_bswap(mpz_ptr rop, mpz_srcptr op, size_t n);
+extern void mpz_pdep(mpz_ptr rop, mpz_srcptr op, mpz_srcptr mask);
+extern void mpz_pext(mpz_ptr rop, mpz_srcptr op, mpz_srcptr mask);
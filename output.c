@@ -0,0 +1,283 @@
+/** @copyright 2025 Sean Kasun */
+#include "output.h"
+#include "mpextras.h"
+#include "utf8.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LEAF_DIGITS 65536
+#define CHUNKED_BITS (1 << 20)  // mpz_get_str takes milliseconds below this
+#define MAX_UNICODE_BITS (1L << 32)  // floats bigger than this aren't truncated to characters
+#define SUMMARY_DIGITS 16  // shown at each end of a summarized integer
+
+static void printBase(FILE *stream, int base) {
+  switch (base) {
+    case 16:
+      fwrite("0x", 1, 2, stream);
+      break;
+    case 2:
+      fwrite("0b", 1, 2, stream);
+      break;
+    case 8:
+      fwrite("0o", 1, 2, stream);
+      break;
+  }
+}
+
+// writes z, which is below 10^(LEAF_DIGITS << level), as exactly that many digits
+static bool putDigits(char *out, mpz_srcptr z, mpz_t *powers, int level) {
+  if (calcStopped()) {
+    return false;
+  }
+  if (level == 0) {
+    char *digits = mpz_get_str(NULL, 10, z);
+    size_t len = strlen(digits);
+    memset(out, '0', LEAF_DIGITS - len);
+    memcpy(out + LEAF_DIGITS - len, digits, len);
+    free(digits);
+    return true;
+  }
+  mpz_t q, r;
+  mpz_init(q);
+  mpz_init(r);
+  mpz_tdiv_qr(q, r, z, powers[level - 1]);
+  bool ok = putDigits(out, q, powers, level - 1) &&
+    putDigits(out + ((size_t)LEAF_DIGITS << (level - 1)), r, powers, level - 1);
+  mpz_clear(q);
+  mpz_clear(r);
+  return ok;
+}
+
+/**
+ * Same as mpz_get_str(NULL, 10, z), but done in pieces so a huge conversion
+ * can be interrupted.  Returns NULL if it was.
+ */
+static char *decimalString(mpz_srcptr z) {
+  size_t digits = mpz_sizeinbase(z, 10);
+  int levels = 0;
+  while ((size_t)LEAF_DIGITS << levels < digits) {
+    levels++;
+  }
+  // powers[i] is 10^(LEAF_DIGITS << i)
+  mpz_t *powers = malloc(levels * sizeof(mpz_t));
+  for (int i = 0; i < levels; i++) {
+    mpz_init(powers[i]);
+    if (i == 0) {
+      mpz_ui_pow_ui(powers[i], 10, LEAF_DIGITS);
+    } else {
+      mpz_mul(powers[i], powers[i - 1], powers[i - 1]);
+    }
+  }
+  size_t len = (size_t)LEAF_DIGITS << levels;
+  char *s = malloc(len + 2);
+  mpz_t a;
+  mpz_init(a);
+  mpz_abs(a, z);
+  bool ok = !calcStopped() && putDigits(s + 1, a, powers, levels);
+  mpz_clear(a);
+  for (int i = 0; i < levels; i++) {
+    mpz_clear(powers[i]);
+  }
+  free(powers);
+  if (!ok) {
+    free(s);
+    return NULL;
+  }
+  char *p = s + 1;
+  while (p < s + len && *p == '0') {
+    p++;
+  }
+  if (mpz_sgn(z) < 0) {
+    *--p = '-';
+  }
+  memmove(s, p, s + len + 1 - p);
+  s[s + len + 1 - p] = 0;
+  return s;
+}
+
+/**
+ * Prints the first and last digits of z and how many digits there are,
+ * without converting the ones in between.  z has more than twice
+ * SUMMARY_DIGITS digits.
+ */
+static void printSummary(FILE *stream, mpz_srcptr z, int base) {
+  mpz_t lead, tail;
+  mpz_init(lead);
+  mpz_init(tail);
+  size_t count;
+  if (base == 10) {
+    mpz_get_leading(lead, &count, base, SUMMARY_DIGITS, z);
+    mpz_ui_pow_ui(tail, base, SUMMARY_DIGITS);
+    mpz_tdiv_r(tail, z, tail);  // a single limb divisor, so one pass
+  } else {
+    int bits = base == 16 ? 4 : base == 8 ? 3 : 1;
+    count = mpz_sizeinbase(z, base);  // exact for these
+    mpz_tdiv_q_2exp(lead, z, bits * (count - SUMMARY_DIGITS));
+    mpz_tdiv_r_2exp(tail, z, bits * SUMMARY_DIGITS);
+  }
+  mpz_abs(lead, lead);
+  mpz_abs(tail, tail);
+  if (mpz_sgn(z) < 0) {
+    fputc('-', stream);
+  }
+  printBase(stream, base);
+  char *s = mpz_get_str(NULL, base, lead);
+  fprintf(stream, "%s...", s);
+  free(s);
+  s = mpz_get_str(NULL, base, tail);
+  for (int len = strlen(s); len < SUMMARY_DIGITS; len++) {
+    fputc('0', stream);
+  }
+  fprintf(stream, "%s (%zu digits)", s, count);
+  free(s);
+  mpz_clear(lead);
+  mpz_clear(tail);
+}
+
+// whether z has more than n digits, since mpz_sizeinbase() can be one over in base 10
+static bool longerThan(mpz_srcptr z, int base, int n) {
+  size_t size = mpz_sizeinbase(z, base);
+  if (base != 10 || size != (size_t)n + 1) {
+    return size > (size_t)n;
+  }
+  mpz_t limit;
+  mpz_init(limit);
+  mpz_ui_pow_ui(limit, 10, n);
+  bool longer = mpz_cmpabs(z, limit) >= 0;
+  mpz_clear(limit);
+  return longer;
+}
+
+/**
+ * Unpacks the 32 bit code points of a string, first one most significant,
+ * and prints them quoted.  Floats are truncated first, and skipped if huge.
+ */
+static void printUnicode(FILE *stream, struct Value val) {
+  long bits = 0;
+  if (val.isF) {
+    mpf_get_d_2exp(&bits, val.f);
+  }
+  if (bits > MAX_UNICODE_BITS) {
+    return;
+  }
+  mpz_t z;
+  mpz_init(z);
+  if (val.isF) {
+    mpz_set_f(z, val.f);
+  } else {
+    mpz_set(z, val.z);
+  }
+  size_t count = (mpz_sizeinbase(z, 2) + 31) / 32;
+  uint32_t *cps = malloc(count * sizeof(uint32_t));
+  mpz_export(cps, &count, 1, sizeof(uint32_t), 0, 0, z);  // zero exports nothing
+  char *utf = malloc(count * 4 + 1);
+  size_t len = utf8Encode(cps, count, utf);
+  char quote = count <= 1 ? '\'' : '"';
+  fputc(quote, stream);
+  fwrite(utf, 1, len, stream);
+  fputc(quote, stream);
+  fputc(' ', stream);
+  free(utf);
+  free(cps);
+  mpz_clear(z);
+}
+
+/**
+ * Returns false if printing a huge integer was interrupted, in which case
+ * nothing but the optional unicode prefix has been written.
+ */
+bool printValue(FILE *stream, struct Value val, struct Format *format) {
+  if (format->unicode) {
+    printUnicode(stream, val);
+  }
+  if (val.isF) {
+    mp_exp_t exp;
+    char *s = format->digits ? mpf_get_str_rounded(&exp, format->base, format->digits, val.f) :
+      mpf_get_str_shortest(&exp, format->base, val.f);
+    int len = strlen(s);
+    char *p = s;
+    if (*p == '-') {
+      fputc('-', stream);
+      p++;
+      len--;
+    }
+    printBase(stream, format->base);
+    if (exp == 0 && len == 0) {
+      fputc('0', stream);
+    }
+    if (exp - len > 8 || exp - len < -8) {
+      fputc(*p++, stream);
+      len--;
+      exp--;
+      fputc('.', stream);
+      fwrite(p, 1, len, stream);
+      if (exp) {
+        fprintf(stream, "e%ld", exp);
+      }
+    } else if (exp < 0) {
+      fwrite("0.", 1, 2, stream);
+      while (exp++ < 0) {
+        fputc('0', stream);
+      }
+      fwrite(p, 1, len, stream);
+    } else {
+      int out = exp;
+      if (out > len) {
+        out = len;
+      }
+      fwrite(p, 1, out, stream);
+      p += exp;
+      len -= exp;
+      while (len < 0) {
+        fputc('0', stream);
+        len++;
+      }
+      fputc('.', stream);
+      if (len > 0) {
+        fwrite(p, 1, len, stream);
+      }
+    }
+    free(s);
+  } else if (format->width && format->base != 10) {
+    // fixed widths show the raw register bits, padded out to the full width
+    int bitsPerDigit = format->base == 16 ? 4 : format->base == 8 ? 3 : 1;
+    int digits = (format->width + bitsPerDigit - 1) / bitsPerDigit;
+    mpz_t bits;
+    mpz_init(bits);
+    mpz_fdiv_r_2exp(bits, val.z, format->width);
+    char *s = mpz_get_str(NULL, format->base, bits);
+    printBase(stream, format->base);
+    for (int len = strlen(s); len < digits; len++) {
+      fputc('0', stream);
+    }
+    fputs(s, stream);
+    free(s);
+    mpz_clear(bits);
+  } else if (format->summary && longerThan(val.z, format->base, format->summary)) {
+    printSummary(stream, val.z, format->base);
+  } else {
+    char *s;
+    if (format->base == 10 && mpz_sizeinbase(val.z, 2) > CHUNKED_BITS) {
+      s = decimalString(val.z);
+      if (!s) {
+        return false;
+      }
+    } else {
+      s = mpz_get_str(NULL, format->base, val.z);
+    }
+    size_t len = strlen(s);
+    char *p = s;
+    if (*p == '-') {
+      fputc('-', stream);
+      p++;
+      len--;
+    }
+    printBase(stream, format->base);
+    fwrite(p, 1, len, stream);
+    free(s);
+  }
+  fputc('\n', stream);
+  return true;
+}
@@ -0,0 +1,16 @@
+/** @copyright 2025 Sean Kasun */
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "calculator.h"
+
+struct Format {
+  int base;
+  bool unicode;
+  int width;  // fixed width integers are shown with every bit
+  int digits;  // floats are rounded to this many significant digits when nonzero
+  int summary;  // integers with more digits are only summarized when nonzero
+};
+
+extern bool printValue(FILE *stream, struct Value val, struct Format *format);
@@ -0,0 +1,108 @@
+/** @copyright 2025 Sean Kasun */
+#include "queue.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define SPINS 1000  // polls of the other side's index before sleeping
+#define LINE 64  // the indices get a cache line each so the two sides don't share one
+
+/**
+ * A bounded ring of pointers between exactly one producer thread and one
+ * consumer thread.  Each side only writes its own index, so passing an item
+ * along takes no locks.  A side that finds the ring full or empty spins for
+ * a while, then sleeps until the other side moves.
+ */
+struct Queue {
+  _Alignas(LINE) atomic_size_t head;  // next slot to pop, only the consumer writes it
+  _Alignas(LINE) atomic_size_t tail;  // next slot to push, only the producer writes it
+  _Alignas(LINE) atomic_int sleepers;
+  size_t mask;
+  void **slots;
+  pthread_mutex_t lock;
+  pthread_cond_t moved;
+};
+
+// capacity must be a power of two
+struct Queue *queueCreate(size_t capacity) {
+  struct Queue *q = aligned_alloc(LINE, sizeof(struct Queue));
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  atomic_init(&q->sleepers, 0);
+  q->mask = capacity - 1;
+  q->slots = malloc(capacity * sizeof(void *));
+  pthread_mutex_init(&q->lock, NULL);
+  pthread_cond_init(&q->moved, NULL);
+  return q;
+}
+
+void queueFree(struct Queue *q) {
+  pthread_mutex_destroy(&q->lock);
+  pthread_cond_destroy(&q->moved);
+  free(q->slots);
+  free(q);
+}
+
+/**
+ * Waits for the other side to move index past seen.  The sleeper count is
+ * raised before index is checked again, and the other side stores index
+ * before checking the count, so at least one of them sees the other.
+ */
+static void await(struct Queue *q, atomic_size_t *index, size_t seen) {
+  for (int i = 0; i < SPINS; i++) {
+    if (atomic_load_explicit(index, memory_order_acquire) != seen) {
+      return;
+    }
+  }
+  pthread_mutex_lock(&q->lock);
+  atomic_fetch_add(&q->sleepers, 1);
+  while (atomic_load(index) == seen) {
+    pthread_cond_wait(&q->moved, &q->lock);
+  }
+  atomic_fetch_sub(&q->sleepers, 1);
+  pthread_mutex_unlock(&q->lock);
+}
+
+static void wake(struct Queue *q) {
+  if (atomic_load(&q->sleepers)) {
+    pthread_mutex_lock(&q->lock);
+    pthread_cond_broadcast(&q->moved);
+    pthread_mutex_unlock(&q->lock);
+  }
+}
+
+// only the producer may call this, it waits while the ring is full
+void queuePush(struct Queue *q, void *item) {
+  size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  size_t head;
+  while (tail - (head = atomic_load_explicit(&q->head, memory_order_acquire)) > q->mask) {
+    await(q, &q->head, head);
+  }
+  q->slots[tail & q->mask] = item;
+  atomic_store(&q->tail, tail + 1);
+  wake(q);
+}
+
+// only the consumer may call this, it waits while the ring is empty
+void *queuePop(struct Queue *q) {
+  size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  while (atomic_load_explicit(&q->tail, memory_order_acquire) == head) {
+    await(q, &q->tail, head);
+  }
+  void *item = q->slots[head & q->mask];
+  atomic_store(&q->head, head + 1);
+  wake(q);
+  return item;
+}
+
+// like queuePop(), but returns false rather than waiting
+bool queueTryPop(struct Queue *q, void **item) {
+  size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  if (atomic_load_explicit(&q->tail, memory_order_acquire) == head) {
+    return false;
+  }
+  *item = q->slots[head & q->mask];
+  atomic_store(&q->head, head + 1);
+  wake(q);
+  return true;
+}
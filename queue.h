@@ -0,0 +1,13 @@
+/** @copyright 2025 Sean Kasun */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct Queue;
+
+extern struct Queue *queueCreate(size_t capacity);
+extern void queueFree(struct Queue *q);
+extern void queuePush(struct Queue *q, void *item);
+extern void *queuePop(struct Queue *q);
+extern bool queueTryPop(struct Queue *q, void **item);
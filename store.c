@@ -0,0 +1,405 @@
+/** @copyright 2025 Sean Kasun */
+#include "store.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Results kept across runs in one file any number of processes share.
+ * The file is a header and then records, only ever appended to under an
+ * exclusive flock, and read through a shared mapping.  When it outgrows
+ * its budget the newest half is copied to a fresh file that's renamed
+ * over it, and everyone else notices the new inode and switches over.
+ */
+#define MAGIC "zxstore1"
+#define REFRESH_SECONDS 0.1  // how stale a miss may be before looking for other processes' appends
+
+struct Header {
+  char magic[8];
+  uint32_t limbBytes;
+  uint32_t reserved;
+};
+
+struct Record {
+  uint64_t a;
+  uint64_t b;
+  uint64_t bytes;  // of the record and its limbs
+  uint64_t check;  // of everything after it, so a torn append is never read
+  int64_t exp;
+  int64_t prec;  // floats only, in bits
+  int64_t lostBits;
+  int64_t roundings;
+  int32_t size;  // in limbs, negative for negative values
+  int32_t isF;
+  mp_limb_t limbs[];
+};
+
+struct Slot {
+  uint64_t a;
+  uint64_t b;
+  size_t offset;
+};
+
+struct Store {
+  char *path;
+  int fd;
+  ino_t inode;
+  const char *map;
+  size_t mapped;
+  size_t end;  // of the last good record
+  size_t maxBytes;
+  struct Slot *slots;
+  size_t numSlots;
+  size_t count;
+  struct timespec refreshed;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t inserts;
+  uint64_t compactions;
+};
+
+static uint64_t mix(uint64_t h, uint64_t w, uint64_t m) {
+  h = (h ^ w) * m;
+  return h ^ (h >> 31);
+}
+
+// two lanes with different multipliers, for 128 bits of key
+static void hashWords(struct StoreKey *k, const uint64_t *w, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    k->a = mix(k->a, w[i], 0x9e3779b97f4a7c15ULL);
+    k->b = mix(k->b, w[i], 0xc4ceb9fe1a85ec53ULL);
+  }
+}
+
+static struct StoreKey finish(struct StoreKey k) {
+  if (!k.a && !k.b) {
+    k.a = 1;
+  }
+  return k;
+}
+
+struct StoreKey storeKeyValue(struct Value v) {
+  struct StoreKey k = {0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL};
+  if (v.isF) {
+    uint64_t head[] = {1, v.f->_mp_size, v.f->_mp_exp};
+    hashWords(&k, head, 3);
+    hashWords(&k, (const uint64_t *)v.f->_mp_d, abs(v.f->_mp_size));
+  } else {
+    uint64_t head[] = {2, v.z->_mp_size};
+    hashWords(&k, head, 2);
+    hashWords(&k, (const uint64_t *)v.z->_mp_d, abs(v.z->_mp_size));
+  }
+  return finish(k);
+}
+
+struct StoreKey storeKeyCombine(uint64_t tag, struct StoreKey l, struct StoreKey r) {
+  struct StoreKey k = {0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL};
+  uint64_t words[] = {3, tag, l.a, l.b, r.a, r.b};
+  hashWords(&k, words, 6);
+  return finish(k);
+}
+
+static uint64_t checksum(const struct Record *r) {
+  struct StoreKey k = {r->a, r->b};
+  const char *start = (const char *)&r->exp;
+  hashWords(&k, (const uint64_t *)start, ((const char *)r + r->bytes - start) / sizeof(uint64_t));
+  return k.a ^ k.b;
+}
+
+static struct Slot *findSlot(struct Store *store, uint64_t a, uint64_t b) {
+  size_t i = a & (store->numSlots - 1);
+  while (store->slots[i].a || store->slots[i].b) {
+    if (store->slots[i].a == a && store->slots[i].b == b) {
+      break;
+    }
+    i = (i + 1) & (store->numSlots - 1);
+  }
+  return &store->slots[i];
+}
+
+static void addSlot(struct Store *store, uint64_t a, uint64_t b, size_t offset) {
+  if ((store->count + 1) * 2 > store->numSlots) {
+    struct Slot *old = store->slots;
+    size_t num = store->numSlots;
+    store->numSlots = num ? num * 2 : 256;
+    store->slots = calloc(store->numSlots, sizeof(struct Slot));
+    store->count = 0;
+    for (size_t i = 0; i < num; i++) {
+      if (old[i].a || old[i].b) {
+        addSlot(store, old[i].a, old[i].b, old[i].offset);
+      }
+    }
+    free(old);
+  }
+  struct Slot *s = findSlot(store, a, b);
+  if (!s->a && !s->b) {
+    store->count++;
+  }
+  s->a = a;
+  s->b = b;
+  s->offset = offset;  // a later duplicate wins, it's the same value anyway
+}
+
+static void detach(struct Store *store) {
+  if (store->map) {
+    munmap((void *)store->map, store->mapped);
+  }
+  store->map = NULL;
+  store->mapped = 0;
+  if (store->fd >= 0) {
+    close(store->fd);
+  }
+  store->fd = -1;
+  free(store->slots);
+  store->slots = NULL;
+  store->numSlots = 0;
+  store->count = 0;
+  store->end = 0;
+}
+
+// on failure the store is closed
+static bool remap(struct Store *store, size_t size) {
+  if (store->map) {
+    munmap((void *)store->map, store->mapped);
+    store->map = NULL;
+    store->mapped = 0;
+  }
+  void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, store->fd, 0);
+  if (map == MAP_FAILED) {  // the index would point nowhere
+    detach(store);
+    return false;
+  }
+  store->map = map;
+  store->mapped = size;
+  return true;
+}
+
+// indexes whole records past the end, stopping at the first torn one
+static void scan(struct Store *store) {
+  while (store->end + sizeof(struct Record) <= store->mapped) {
+    const struct Record *r = (const struct Record *)(store->map + store->end);
+    size_t limbs = labs(r->size);
+    if (r->bytes != sizeof(struct Record) + limbs * sizeof(mp_limb_t) ||
+        r->bytes > store->mapped - store->end || checksum(r) != r->check) {
+      break;
+    }
+    addSlot(store, r->a, r->b, store->end);
+    store->end += r->bytes;
+  }
+}
+
+/**
+ * Opens the file at path, creating it if need be, and indexes it, leaving
+ * it exclusively locked.  On failure the store is left closed, and lookups
+ * and inserts do nothing from then on.
+ */
+static bool attach(struct Store *store) {
+  store->fd = open(store->path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (store->fd < 0) {
+    return false;
+  }
+  flock(store->fd, LOCK_EX);
+  struct stat st;
+  fstat(store->fd, &st);
+  store->inode = st.st_ino;
+  struct Header header = {MAGIC, sizeof(mp_limb_t), 0};
+  if (st.st_size == 0) {
+    if (pwrite(store->fd, &header, sizeof(header), 0) != sizeof(header)) {
+      detach(store);
+      return false;
+    }
+    st.st_size = sizeof(header);
+  }
+  if ((size_t)st.st_size < sizeof(header) || !remap(store, st.st_size) ||
+      memcmp(store->map, &header, sizeof(header))) {
+    detach(store);
+    return false;
+  }
+  store->end = sizeof(header);
+  scan(store);
+  return true;
+}
+
+// picks up appends and compactions by other processes, with the file locked
+static bool refresh(struct Store *store) {
+  struct stat st;
+  if (stat(store->path, &st) || st.st_ino != store->inode) {
+    detach(store);
+    return attach(store);
+  }
+  fstat(store->fd, &st);
+  if ((size_t)st.st_size > store->mapped) {
+    if (!remap(store, st.st_size)) {
+      return false;
+    }
+    scan(store);
+  }
+  return true;
+}
+
+struct Store *storeOpen(const char *path, size_t maxBytes) {
+  struct Store *store = calloc(1, sizeof(struct Store));
+  store->path = strdup(path);
+  store->maxBytes = maxBytes;
+  store->fd = -1;
+  if (!attach(store)) {
+    storeClose(store);
+    return NULL;
+  }
+  flock(store->fd, LOCK_UN);
+  clock_gettime(CLOCK_MONOTONIC, &store->refreshed);
+  return store;
+}
+
+void storeClose(struct Store *store) {
+  detach(store);
+  free(store->path);
+  free(store);
+}
+
+static bool stale(struct Store *store) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double age = (now.tv_sec - store->refreshed.tv_sec) + (now.tv_nsec - store->refreshed.tv_nsec) / 1e9;
+  if (age < REFRESH_SECONDS) {
+    return false;
+  }
+  store->refreshed = now;
+  return true;
+}
+
+static const struct Record *lookup(struct Store *store, struct StoreKey key) {
+  if (!store->slots) {
+    return NULL;
+  }
+  struct Slot *s = findSlot(store, key.a, key.b);
+  if (!s->a && !s->b) {
+    return NULL;
+  }
+  return (const struct Record *)(store->map + s->offset);
+}
+
+// on a hit v is set to a copy of the stored value, straight from its limbs
+bool storeFind(struct Store *store, struct StoreKey key, struct Value *v, long *lostBits,
+               long *roundings) {
+  const struct Record *r = lookup(store, key);
+  if (!r && store->fd >= 0 && stale(store)) {
+    flock(store->fd, LOCK_SH);
+    bool ok = refresh(store);
+    if (store->fd >= 0) {
+      flock(store->fd, LOCK_UN);
+    }
+    if (ok) {
+      r = lookup(store, key);
+    }
+  }
+  if (!r) {
+    store->misses++;
+    return false;
+  }
+  size_t limbs = abs(r->size);
+  v->pending = NULL;
+  if (r->isF) {
+    v->isF = true;
+    mpf_init2(v->f, r->prec);
+    if (limbs > (size_t)v->f->_mp_prec + 1) {
+      mpf_clear(v->f);
+      store->misses++;
+      return false;
+    }
+    memcpy(v->f->_mp_d, r->limbs, limbs * sizeof(mp_limb_t));
+    v->f->_mp_size = r->size;
+    v->f->_mp_exp = r->exp;
+  } else {
+    v->isF = false;
+    mpz_init(v->z);
+    if (limbs) {
+      memcpy(mpz_limbs_write(v->z, limbs), r->limbs, limbs * sizeof(mp_limb_t));
+      mpz_limbs_finish(v->z, r->size);
+    }
+  }
+  *lostBits = r->lostBits;
+  *roundings = r->roundings;
+  store->hits++;
+  return true;
+}
+
+// keeps the newest records that fit in keep bytes, renaming a fresh file over the old one
+static bool compact(struct Store *store, size_t keep) {
+  size_t from = sizeof(struct Header);
+  while (store->end - from > keep) {
+    from += ((const struct Record *)(store->map + from))->bytes;
+  }
+  char *tmp = malloc(strlen(store->path) + 8);
+  sprintf(tmp, "%s.XXXXXX", store->path);
+  int fd = mkstemp(tmp);
+  if (fd < 0) {
+    free(tmp);
+    return false;
+  }
+  size_t len = store->end - from;
+  bool ok = write(fd, store->map, sizeof(struct Header)) == sizeof(struct Header) &&
+    write(fd, store->map + from, len) == (ssize_t)len;
+  fchmod(fd, 0644);
+  close(fd);
+  if (!ok || rename(tmp, store->path)) {
+    unlink(tmp);
+    free(tmp);
+    return false;
+  }
+  free(tmp);
+  store->compactions++;
+  return refresh(store);
+}
+
+void storeInsert(struct Store *store, struct StoreKey key, struct Value v, long lostBits,
+                 long roundings) {
+  size_t limbs = abs(v.isF ? v.f->_mp_size : v.z->_mp_size);
+  size_t bytes = sizeof(struct Record) + limbs * sizeof(mp_limb_t);
+  if (store->fd < 0 || bytes > store->maxBytes / 4) {
+    return;
+  }
+  struct Record *r = malloc(bytes);
+  r->a = key.a;
+  r->b = key.b;
+  r->bytes = bytes;
+  r->exp = v.isF ? v.f->_mp_exp : 0;
+  r->prec = v.isF ? mpf_get_prec(v.f) : 0;
+  r->lostBits = lostBits;
+  r->roundings = roundings;
+  r->size = v.isF ? v.f->_mp_size : v.z->_mp_size;
+  r->isF = v.isF;
+  memcpy(r->limbs, v.isF ? v.f->_mp_d : v.z->_mp_d, limbs * sizeof(mp_limb_t));
+  r->check = checksum(r);
+
+  flock(store->fd, LOCK_EX);
+  bool ok = refresh(store);
+  if (ok && store->end + bytes > store->maxBytes) {
+    ok = compact(store, store->maxBytes / 2);
+  }
+  // anything past the last good record was torn by a writer that died
+  if (ok && !ftruncate(store->fd, store->end) &&
+      pwrite(store->fd, r, bytes, store->end) == (ssize_t)bytes && remap(store, store->end + bytes)) {
+    addSlot(store, key.a, key.b, store->end);
+    store->end += bytes;
+    store->inserts++;
+  }
+  if (store->fd >= 0) {
+    flock(store->fd, LOCK_UN);
+  }
+  free(r);
+}
+
+void storeStats(struct Store *store, FILE *out) {
+  uint64_t lookups = store->hits + store->misses;
+  fprintf(out, "disk cache: %llu hits, %llu misses (%.1f%% hit rate), %llu stored, "
+          "%llu compactions, %zu entries using %zu of %zu bytes\n",
+          (unsigned long long)store->hits, (unsigned long long)store->misses,
+          lookups ? 100.0 * store->hits / lookups : 0.0, (unsigned long long)store->inserts,
+          (unsigned long long)store->compactions, store->count, store->end, store->maxBytes);
+}
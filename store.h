@@ -0,0 +1,29 @@
+/** @copyright 2025 Sean Kasun */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "calculator.h"
+
+struct Store;
+
+/**
+ * Names a value by its content, or an expression by its operator and the
+ * keys of its operands.  All zero means there is no key.
+ */
+struct StoreKey {
+  uint64_t a;
+  uint64_t b;
+};
+
+extern struct Store *storeOpen(const char *path, size_t maxBytes);
+extern void storeClose(struct Store *store);
+extern bool storeFind(struct Store *store, struct StoreKey key, struct Value *v, long *lostBits,
+                      long *roundings);
+extern void storeInsert(struct Store *store, struct StoreKey key, struct Value v, long lostBits,
+                        long roundings);
+extern void storeStats(struct Store *store, FILE *out);
+extern struct StoreKey storeKeyValue(struct Value v);
+extern struct StoreKey storeKeyCombine(uint64_t tag, struct StoreKey l, struct StoreKey r);
@@ -0,0 +1,124 @@
+/** @copyright 2025 Sean Kasun */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+#include "calculator.h"
+#include "convert.h"
+#include "output.h"
+
+/**
+ * Converts random numbers between every pair of bases with convertStream()
+ * and fails on any that don't come out the way printValue() shows the same
+ * number.  The numbers are around the sizes where the word path hands over
+ * to GMP, with and without signs, prefixes and leading zeros.
+ *
+ *   zx_convert [numbers per pair] [seed]
+ */
+
+static const int bases[] = {10, 16, 8, 2};
+
+static unsigned long seed;
+
+static unsigned pick(unsigned n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (seed >> 33) % n;
+}
+
+static const char *prefix(int base) {
+  return base == 16 ? "0x" : base == 8 ? "0o" : base == 2 ? "0b" : "";
+}
+
+// a number in base as --convert takes it, and the same number as calculate() takes it
+static void randomNumber(gmp_randstate_t rand, int base, char *token, char *expr) {
+  mpz_t z;
+  mpz_init(z);
+  // up to a bit past 64, where most of the word sized cases are
+  int bits = pick(4) ? pick(70) : pick(300);
+  mpz_urandomb(z, rand, bits);
+  char *digits = mpz_get_str(NULL, base, z);
+  bool neg = pick(3) == 0;
+  const char *sign = neg ? "-" : pick(8) == 0 ? "+" : "";
+  const char *pre = pick(2) ? prefix(base) : "";
+  const char *zeros = pick(6) == 0 ? "000" : "";
+  if (pick(2)) {  // either case of hex digits
+    for (char *p = digits; *p; p++) {
+      if (*p >= 'a') {
+        *p -= 'a' - 'A';
+      }
+    }
+  }
+  sprintf(token, "%s%s%s%s", sign, pre, zeros, digits);
+  sprintf(expr, "%s%s%s%s", neg ? "-" : "", prefix(base), zeros, digits);
+  free(digits);
+  mpz_clear(z);
+}
+
+static char *printed(const char *expr, int base) {
+  struct Value v;
+  valueInitZ(&v);
+  v = calculate(expr, v);
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream(&buf, &len);
+  struct Format format = {.base = base};
+  printValue(out, v, &format);
+  fclose(out);
+  valueClear(&v);
+  return buf;
+}
+
+static int checkPair(gmp_randstate_t rand, int from, int to, int count) {
+  char (*tokens)[400] = malloc(count * sizeof(*tokens));
+  char (*exprs)[400] = malloc(count * sizeof(*exprs));
+  char *input = NULL;
+  size_t inputLen = 0;
+  FILE *in = open_memstream(&input, &inputLen);
+  for (int i = 0; i < count; i++) {
+    randomNumber(rand, from, tokens[i], exprs[i]);
+    fprintf(in, "%s\n", tokens[i]);
+  }
+  fclose(in);
+  char *output = NULL;
+  size_t outputLen = 0;
+  in = fmemopen(input, inputLen, "r");
+  FILE *out = open_memstream(&output, &outputLen);
+  bool ok = convertStream(in, out, from, to);
+  fclose(in);
+  fclose(out);
+  int bad = !ok;
+  char *line = output;
+  for (int i = 0; i < count && !bad; i++) {
+    char *end = strchr(line, '\n');
+    char *want = printed(exprs[i], to);
+    if (!end || strncmp(line, want, end + 1 - line)) {
+      fprintf(stderr, "error: %d:%d %s gave %.*s, printValue gives %s", from, to, tokens[i],
+              end ? (int)(end - line) : 0, line, want);
+      bad++;
+    }
+    free(want);
+    line = end + 1;
+  }
+  free(output);
+  free(input);
+  free(exprs);
+  free(tokens);
+  return bad;
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 20000;
+  seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+  gmp_randstate_t rand;
+  gmp_randinit_default(rand);
+  gmp_randseed_ui(rand, seed);
+  int failed = 0;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      failed += checkPair(rand, bases[i], bases[j], count);
+    }
+  }
+  gmp_randclear(rand);
+  printf("%d numbers, %d base pairs differ\n", count * 16, failed);
+  return failed ? 1 : 0;
+}
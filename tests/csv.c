@@ -0,0 +1,203 @@
+/** @copyright 2025 Sean Kasun */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <gmp.h>
+#include "calculator.h"
+#include "csv.h"
+#include "output.h"
+
+/**
+ * Runs random rows through runCsv() and fails on any row whose output or
+ * error differs from calculate() on the same formula with the row's cells
+ * put in for $1, $2 and $3.  The rows mix small integers, which take the
+ * batched int64 path, with ones that overflow it, cells that aren't
+ * integers, zeros to divide by and rows missing a column.  The batched
+ * path is checked to be taken at all, and to hand overflows back.
+ *
+ *   zx_csv [rows] [seed]
+ */
+
+#define MAX_CELL 64
+
+static const char *formulas[] = {
+  "$1 * 3 + $2 - $3",
+  "$1 / $2 + $3 % 7",
+  "$1 * $2 * $3",
+  "($1 << 3) - $2 ** 2",
+  "-$1 + $3 / ($2 - $1)",
+};
+
+static unsigned long seed;
+
+static unsigned pick(unsigned n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (seed >> 33) % n;
+}
+
+static void randomCell(char *cell) {
+  switch (pick(10)) {
+    case 0:  // overflows int64 when multiplied or shifted
+      sprintf(cell, "%s%llu", pick(2) ? "-" : "", 4000000000000000000ULL + pick(1000));
+      break;
+    case 1:  // doesn't fit int64 at all
+      strcpy(cell, pick(2) ? "123456789012345678901234567890" : "-9223372036854775809");
+      break;
+    case 2:  // not an integer
+      strcpy(cell, pick(2) ? "2.5" : "0x1f");
+      break;
+    case 3:
+      strcpy(cell, "0");
+      break;
+    default:
+      sprintf(cell, "%d", (int)pick(2000) - 1000);
+  }
+}
+
+// the formula with each $n replaced by the nth cell in parentheses
+static void substitute(char *out, const char *formula, char cells[3][MAX_CELL], int count) {
+  for (const char *p = formula; *p; p++) {
+    if (*p == '$') {
+      int n = *++p - '1';
+      out += sprintf(out, "(%s)", n < count ? cells[n] : "");
+    } else {
+      *out++ = *p;
+    }
+  }
+  *out = 0;
+}
+
+// what runCsv() should print for the row, and the error it should report or an empty string
+static void expected(const char *formula, char cells[3][MAX_CELL], int count, char **text,
+                     char *error) {
+  *error = 0;
+  *text = NULL;
+  size_t len;
+  FILE *out = open_memstream(text, &len);
+  for (int i = 0; i < count; i++) {  // each cell is worked out on its own first
+    struct Value v;
+    valueInitZ(&v);
+    v = calculate(cells[i], v);
+    valueClear(&v);
+    if (calcError()) {
+      strcpy(error, calcError());
+      break;
+    }
+  }
+  if (!*error && count < 3 && strstr(formula, "$3")) {
+    strcpy(error, "Missing column");
+  }
+  if (!*error) {
+    char expr[256];
+    substitute(expr, formula, cells, count);
+    struct Value v;
+    valueInitZ(&v);
+    v = calculate(expr, v);
+    if (calcError()) {
+      strcpy(error, calcError());
+    } else {
+      struct Format format = {.base = 10};
+      printValue(out, v, &format);
+    }
+    valueClear(&v);
+  }
+  if (*error) {
+    fputc('\n', out);
+  }
+  fclose(out);
+}
+
+static int checkFormula(const char *formula, int rows) {
+  char (*cells)[3][MAX_CELL] = malloc(rows * sizeof(*cells));
+  int *counts = malloc(rows * sizeof(int));
+  char *input = NULL;
+  size_t inputLen = 0;
+  FILE *in = open_memstream(&input, &inputLen);
+  for (int i = 0; i < rows; i++) {
+    counts[i] = pick(20) ? 3 : 2;
+    for (int c = 0; c < counts[i]; c++) {
+      randomCell(cells[i][c]);
+      fprintf(in, "%s%s", c ? ", " : "", cells[i][c]);
+    }
+    fputc('\n', in);
+  }
+  fclose(in);
+  // runCsv() reports errors on stderr, so that goes to a file for the length of the run
+  FILE *errors = tmpfile();
+  fflush(stderr);
+  int saved = dup(fileno(stderr));
+  dup2(fileno(errors), fileno(stderr));
+  char *output = NULL;
+  size_t outputLen = 0;
+  in = fmemopen(input, inputLen, "r");
+  FILE *out = open_memstream(&output, &outputLen);
+  struct Format format = {.base = 10};
+  bool ok = runCsv(in, out, formula, ',', &format);
+  fclose(in);
+  fclose(out);
+  fflush(stderr);
+  dup2(saved, fileno(stderr));
+  close(saved);
+  rewind(errors);
+  int bad = !ok;
+  char *line = output;
+  char *reported = NULL;
+  size_t cap = 0;
+  for (int i = 0; i < rows && !bad; i++) {
+    char *text, error[256];
+    expected(formula, cells[i], counts[i], &text, error);
+    char *end = strchr(line, '\n');
+    bool same = end && !strncmp(line, text, end + 1 - line);
+    if (same && *error) {
+      ssize_t n = getline(&reported, &cap, errors);
+      same = n > 0 && !strncmp(reported, "error: ", 7) && !strncmp(reported + 7, error, strlen(error));
+    }
+    if (!same) {
+      fprintf(stderr, "error: %s row %d (%s, %s, %s) gave %.*s, calculate() gives %s%s\n", formula,
+              i, cells[i][0], cells[i][1], counts[i] > 2 ? cells[i][2] : "-",
+              end ? (int)(end - line) : 0, line, *error ? "error " : "", *error ? error : text);
+      bad++;
+    }
+    free(text);
+    line = end + 1;
+  }
+  free(reported);
+  fclose(errors);
+  free(output);
+  free(input);
+  free(counts);
+  free(cells);
+  return bad;
+}
+
+// small rows take the int64 path, and a product past int64 is handed back
+static bool checkBatched() {
+  struct Expression *e = calcCompile("$1 * $2 + 1");
+  int64_t a[3] = {3, -7, 4000000000000000000LL};
+  int64_t b[3] = {5, 6, 3};
+  int64_t *columns[2] = {a, b};
+  int64_t out[3];
+  bool bad[3] = {false, false, false};
+  bool ok = e && calcEvalBatch(e, columns, 3, out, bad) && !bad[0] && out[0] == 16 &&
+    !bad[1] && out[1] == -41 && bad[2];
+  if (!ok) {
+    fprintf(stderr, "error: $1 * $2 + 1 wasn't batched, or didn't flag its overflow\n");
+  }
+  if (e) {
+    calcFree(e);
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  int rows = argc > 1 ? atoi(argv[1]) : 5000;
+  seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+  int failed = !checkBatched();
+  for (size_t i = 0; i < sizeof(formulas) / sizeof(formulas[0]); i++) {
+    failed += checkFormula(formulas[i], rows);
+  }
+  printf("%d rows of %zu formulas, %d failed\n", rows, sizeof(formulas) / sizeof(formulas[0]),
+         failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,298 @@
+/** @copyright 2025 Sean Kasun */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+#include "calculator.h"
+#include "mpextras.h"
+
+/**
+ * Works out the same lines with the optimizer on and off and fails on any
+ * difference in value, type or error.  The lines are a fixed list of the
+ * shapes the shortcuts look for, then random expressions from a seed, each
+ * for several values of $ in each mode.  Lines go through calculate(), the
+ * compiled line --wire-in uses and the compiled expression --csv uses.
+ * With =digits, a result the double fast path hands back has to show the
+ * same digits as all of it, which it's then worked out to.
+ *
+ *   zx_optimizer [random lines] [seed]
+ */
+
+#define MAX_LINE 4096
+
+static const char *fixed[] = {
+  "$ ** 2",
+  "$ ** 0.5",
+  "$ ** 3",
+  "$ ** -2",
+  "(-$) ** 3",
+  "$ ** 0",
+  "2 ** 10",
+  "3 ** 40",
+  "12345 ** 4",
+  "12345 ** 40",
+  "-3 ** 3",
+  "2.5 ** 2",
+  "0 ** 0",
+  "0 ** -1",
+  "-8 ** 0.5",
+  "--$",
+  "+$",
+  "-+-$",
+  "$ * 8",
+  "8 * $",
+  "$ / 16",
+  "-$ / 16",
+  "$ * 2 + 3 * 4",
+  "sqrt 2 * $ + pi",
+  "(1 << 70) * $ - 5 ** 2",
+  "$ % 7 + 100 / 3",
+  "1 / 0 + $",
+  "$ / (2 - 2)",
+  "sin(pi / 6) * $",
+  "floor(2.5 ** 3) & $",
+  "~(3 * 5) ^ $",
+  "$ >> (10 / 5)",
+  "(",
+  "$ +",
+};
+
+static const char *values[] = {
+  "0", "1", "7", "-3", "2.5", "-0.75", "1e20", "12345678901234567890", "0x8000000000000000",
+};
+
+static const char *leaves[] = {
+  "$", "$", "$", "0", "1", "2", "3", "7", "8", "-5", "1024", "0.5", "2.5", "pi", "sqrt 2",
+  "100000007",
+};
+
+static const char *binary[] = {
+  "+", "-", "*", "/", "%", "**", "<<", ">>", "&", "|", "^",
+};
+
+static const char *unary[] = {
+  "-", "+", "--", "~", "floor", "sqrt",
+};
+
+// small enough that shifts and powers don't make numbers too big to compare quickly
+static const char *exponents[] = {
+  "0", "1", "2", "3", "4", "0.5", "-1", "-2", "10", "40",
+};
+
+static unsigned long seed;
+static int digits = 0;  // =digits, 0 when it's off
+
+static unsigned pick(unsigned n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (seed >> 33) % n;
+}
+
+#define PICK(a) a[pick(sizeof(a) / sizeof(a[0]))]
+
+static void append(char *line, const char *s) {
+  if (strlen(line) + strlen(s) < MAX_LINE) {
+    strcat(line, s);
+  }
+}
+
+static void randomExpr(char *line, int depth) {
+  int kind = depth <= 0 ? 0 : pick(5);
+  if (kind == 0) {
+    append(line, PICK(leaves));
+  } else if (kind == 1) {
+    append(line, PICK(unary));
+    append(line, "(");
+    randomExpr(line, depth - 1);
+    append(line, ")");
+  } else {
+    const char *op = PICK(binary);
+    append(line, "(");
+    randomExpr(line, depth - 1);
+    append(line, ") ");
+    append(line, op);
+    append(line, " ");
+    if (!strcmp(op, "**") || !strcmp(op, "<<") || !strcmp(op, ">>")) {
+      append(line, PICK(exponents));
+    } else {
+      append(line, "(");
+      randomExpr(line, depth - 1);
+      append(line, ")");
+    }
+  }
+}
+
+struct Result {
+  struct Value v;
+  char error[256];  // empty if there wasn't one
+  bool shown;  // false if it was a double's worth that showed other digits than all of it
+};
+
+// the digits =digits shows
+static bool sameDigits(mpf_srcptr a, mpf_srcptr b) {
+  mp_exp_t aExp, bExp;
+  char *x = mpf_get_str_rounded(&aExp, 10, digits, a);
+  char *y = mpf_get_str_rounded(&bExp, 10, digits, b);
+  bool same = aExp == bExp && !strcmp(x, y);
+  free(x);
+  free(y);
+  return same;
+}
+
+static void finish(struct Result *r, struct Value v) {
+  const char *err = calcError();
+  snprintf(r->error, sizeof(r->error), "%s", err ? err : "");
+  r->shown = true;
+  if (calcPartial(v)) {
+    struct Value part;
+    valueSet(&part, v);
+    calcSettle(&v);
+    r->shown = !calcPartial(v) && sameDigits(part.f, v.f);
+    valueClear(&part);
+  }
+  r->v = v;
+}
+
+// when compiling failed, so there's no value
+static void compileError(struct Result *r) {
+  finish(r, (struct Value){.isF = false});
+  mpz_init(r->v.z);
+}
+
+static struct Value number(const char *text) {
+  struct Value v;
+  valueInitZ(&v);
+  return calculate(text, v);
+}
+
+static bool same(struct Result *a, struct Result *b) {
+  if (!a->shown || !b->shown || strcmp(a->error, b->error)) {
+    return false;
+  }
+  if (a->error[0]) {  // the value that comes with an error is never shown
+    return true;
+  }
+  if (a->v.isF != b->v.isF) {
+    return false;
+  }
+  if (!a->v.isF) {
+    return !mpz_cmp(a->v.z, b->v.z);
+  }
+  return !mpf_cmp(a->v.f, b->v.f);
+}
+
+static void show(const char *how, struct Result *r) {
+  if (!r->shown) {
+    fprintf(stderr, "  %-12s showed other digits before it was worked out\n", how);
+  }
+  if (r->error[0]) {
+    fprintf(stderr, "  %-12s error: %s\n", how, r->error);
+  } else if (r->v.isF) {
+    gmp_fprintf(stderr, "  %-12s %.40Fg\n", how, r->v.f);
+  } else {
+    gmp_fprintf(stderr, "  %-12s %Zd\n", how, r->v.z);
+  }
+}
+
+static bool check(const char *line, const char *mode) {
+  char columns[MAX_LINE * 2];  // the same line with $1 for $, for calcCompile()
+  char *c = columns;
+  for (const char *p = line; *p; p++) {
+    *c++ = *p;
+    if (*p == '$') {
+      *c++ = '1';
+    }
+  }
+  *c = 0;
+  bool ok = true;
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]) && ok; i++) {
+    struct Result plain, fast, wire, csvPlain, csvFast;
+    struct Value prev = number(values[i]);
+    struct Value copy;
+    calcSetOptimize(false);
+    valueSet(&copy, prev);
+    finish(&plain, calculate(line, copy));
+    struct Expression *e = calcCompile(columns);
+    if (e) {
+      finish(&csvPlain, calcEvalRow(e, &prev));
+      calcFree(e);
+    } else {
+      compileError(&csvPlain);
+    }
+    calcSetOptimize(true);
+    valueSet(&copy, prev);
+    finish(&fast, calculate(line, copy));
+    e = calcCompile(columns);
+    if (e) {
+      finish(&csvFast, calcEvalRow(e, &prev));
+      calcFree(e);
+    } else {
+      compileError(&csvFast);
+    }
+    e = calcCompileLine(line);
+    if (e) {
+      valueSet(&copy, prev);
+      finish(&wire, calcEvalLine(e, copy));
+      calcFree(e);
+    } else if (calcError()) {
+      compileError(&wire);
+    } else {  // not a line it compiles, so calculate() is used anyway
+      valueSet(&wire.v, plain.v);
+      snprintf(wire.error, sizeof(wire.error), "%s", plain.error);
+      wire.shown = plain.shown;
+    }
+    ok = same(&plain, &fast) && same(&plain, &wire) && same(&csvPlain, &csvFast);
+    if (!ok) {
+      fprintf(stderr, "error: %s, $ = %s: %s\n", mode, values[i], line);
+      show("unoptimized", &plain);
+      show("optimized", &fast);
+      show("--wire-in", &wire);
+      show("csv", &csvPlain);
+      show("csv fast", &csvFast);
+    }
+    valueClear(&plain.v);
+    valueClear(&fast.v);
+    valueClear(&wire.v);
+    valueClear(&csvPlain.v);
+    valueClear(&csvFast.v);
+    valueClear(&prev);
+  }
+  return ok;
+}
+
+// every line in each mode, since fixed width and modular arithmetic take their own paths
+static bool checkModes(const char *line) {
+  mpz_t n;
+  mpz_init_set_ui(n, 1000000007);
+  bool ok = check(line, "default");
+  calcSetWidth(32, true);
+  ok = ok && check(line, "=i32");
+  calcSetWidth(64, false);
+  ok = ok && check(line, "=u64");
+  calcSetWidth(0, false);
+  calcSetModulus(n);
+  ok = ok && check(line, "=mod 1000000007");
+  calcSetModulus(NULL);
+  calcSetDigits(digits = 15, 10);
+  ok = ok && check(line, "=digits 15");
+  calcSetDigits(digits = 0, 10);
+  mpz_clear(n);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  long count = argc > 1 ? atol(argv[1]) : 2000;
+  seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+  calcSetTimeLimit(1);
+  int failed = 0;
+  for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++) {
+    failed += !checkModes(fixed[i]);
+  }
+  char line[MAX_LINE];
+  for (long i = 0; i < count; i++) {
+    line[0] = 0;
+    randomExpr(line, 1 + pick(5));
+    failed += !checkModes(line);
+  }
+  printf("%ld lines, %d differ\n", count + (long)(sizeof(fixed) / sizeof(fixed[0])), failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+/** @copyright 2025 Sean Kasun */
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * Pipes a script through zx and fails unless it prints what the script
+ * expects.  Lines starting with "> " are expected on stdout and lines
+ * starting with "! " are expected as errors on stderr, each in the order
+ * they're written.  Lines starting with "#" are comments and every other
+ * line is input.
+ *
+ *   zx_script SCRIPT...
+ */
+
+extern char **environ;
+
+// everything in f from the start
+static char *slurp(FILE *f) {
+  rewind(f);
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream(&buf, &len);
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    fputc(c, out);
+  }
+  fclose(out);
+  return buf;
+}
+
+static bool same(const char *script, const char *stream, const char *want, const char *got) {
+  if (!strcmp(want, got)) {
+    return true;
+  }
+  fprintf(stderr, "error: %s printed the wrong %s\n--- expected\n%s--- got\n%s---\n", script,
+          stream, want, got);
+  return false;
+}
+
+static bool runScript(const char *script) {
+  FILE *f = fopen(script, "r");
+  if (!f) {
+    fprintf(stderr, "error: Can't read %s\n", script);
+    return false;
+  }
+  FILE *input = tmpfile(), *out = tmpfile(), *err = tmpfile();
+  char *wantOut = NULL, *wantErr = NULL;
+  size_t outLen = 0, errLen = 0;
+  FILE *expectOut = open_memstream(&wantOut, &outLen);
+  FILE *expectErr = open_memstream(&wantErr, &errLen);
+  char *line = NULL;
+  size_t cap = 0;
+  while (getline(&line, &cap, f) > 0) {
+    if (!strncmp(line, "> ", 2)) {
+      fputs(line + 2, expectOut);
+    } else if (!strncmp(line, "! ", 2)) {
+      fprintf(expectErr, "error: %s", line + 2);
+    } else if (*line != '#') {
+      fputs(line, input);
+    }
+  }
+  free(line);
+  fclose(f);
+  fclose(expectOut);
+  fclose(expectErr);
+  fflush(input);
+  rewind(input);
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fileno(input), 0);
+  posix_spawn_file_actions_adddup2(&actions, fileno(out), 1);
+  posix_spawn_file_actions_adddup2(&actions, fileno(err), 2);
+  char *args[] = {ZX_PATH, NULL};
+  pid_t pid;
+  int status;
+  bool ok = !posix_spawn(&pid, args[0], &actions, NULL, args, environ) &&
+    waitpid(pid, &status, 0) >= 0 && WIFEXITED(status) && !WEXITSTATUS(status);
+  posix_spawn_file_actions_destroy(&actions);
+  if (!ok) {
+    fprintf(stderr, "error: Can't run %s on %s\n", ZX_PATH, script);
+  } else {
+    char *gotOut = slurp(out), *gotErr = slurp(err);
+    ok = same(script, "results", wantOut, gotOut) & same(script, "errors", wantErr, gotErr);
+    free(gotOut);
+    free(gotErr);
+  }
+  free(wantOut);
+  free(wantErr);
+  fclose(input);
+  fclose(out);
+  fclose(err);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  bool ok = true;
+  for (int i = 1; i < argc; i++) {
+    ok = runScript(argv[i]) && ok;
+  }
+  return ok ? 0 : 1;
+}
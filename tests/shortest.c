@@ -0,0 +1,161 @@
+/** @copyright 2025 Sean Kasun */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+#include <mpfr.h>
+#include "calculator.h"
+#include "mpextras.h"
+#include "output.h"
+
+/**
+ * Checks that mpf_get_str_shortest() reads back.  Random floats at several
+ * precisions, cut off, sums of short values, and ones holding more bits
+ * than their precision, have to read back as the same value at that
+ * precision in every base.  Unless they hold more bits, one digit fewer
+ * mustn't.  Then a few lines have to print the way they always have.
+ *
+ *   zx_shortest [floats per precision] [seed]
+ */
+
+static const int bases[] = {10, 16, 8, 2};
+static const int precs[] = {64, 128, 200, 1000};
+
+static const char *lines[][2] = {
+  {"100000000000000000000.5", "100000000000000000000.5\n"},
+  {"100000000000000000001.", "100000000000000000001.\n"},
+  {"1/10.", ".1\n"},
+  {"2.5 * 3", "7.5\n"},
+  {"sqrt 2", "1.4142135623730950488\n"},
+  {"-1/1024.", "-9.765625e-4\n"},
+};
+
+static unsigned long seed;
+
+static unsigned pick(unsigned n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (seed >> 33) % n;
+}
+
+static void randomFloat(gmp_randstate_t rand, mpf_ptr f, int prec) {
+  mpf_t g;
+  mpf_init2(g, prec);
+  switch (pick(4)) {
+    case 0:
+      mpf_urandomb(f, rand, prec);
+      break;
+    case 1:  // cut off
+      mpf_urandomb(g, rand, prec);
+      mpf_set_ui(f, 1 + pick(1000));
+      mpf_div(f, f, g);
+      break;
+    case 2:  // a short integer part and a long fraction
+      mpf_urandomb(f, rand, prec);
+      mpf_set_ui(g, pick(1000));
+      mpf_add(f, f, g);
+      break;
+    default:  // more bits than the precision
+      mpf_urandomb(f, rand, prec + GMP_NUMB_BITS);
+      break;
+  }
+  mpf_mul_2exp(f, f, pick(400));
+  if (pick(2)) {
+    mpf_div_2exp(f, f, pick(800));
+  }
+  if (pick(2)) {
+    mpf_neg(f, f);
+  }
+  mpf_clear(g);
+}
+
+// whether digits, as mpf_get_str() gives them, read back as x
+static bool readsAs(mpfr_srcptr x, const char *digits, mp_exp_t exp, int base) {
+  bool neg = *digits == '-';
+  char *text = malloc(strlen(digits) + 32);
+  sprintf(text, "%s0.%s@%ld", neg ? "-" : "", digits + neg, (long)exp);
+  mpfr_t y;
+  mpfr_init2(y, mpfr_get_prec(x));
+  mpfr_strtofr(y, text, NULL, base, MPFR_RNDN);
+  bool same = mpfr_equal_p(x, y);
+  mpfr_clear(y);
+  free(text);
+  return same;
+}
+
+static int check(mpf_srcptr f, int base) {
+  mpfr_t x;
+  mpfr_init2(x, mpf_get_prec(f));
+  mpfr_set_f(x, f, MPFR_RNDN);
+  mpfr_t exact;
+  mpfr_init2(exact, mpf_get_prec(f) + 2 * GMP_NUMB_BITS);
+  mpfr_set_f(exact, f, MPFR_RNDN);
+  bool more = mpfr_min_prec(exact) > mpfr_get_prec(x);
+  mp_exp_t exp;
+  char *digits = mpf_get_str_shortest(&exp, base, f);
+  size_t len = strlen(digits) - (*digits == '-');
+  int bad = 0;
+  if (!len || !readsAs(x, digits, exp, base)) {
+    fprintf(stderr, "error: base %d digits %s e%ld don't read back\n", base, digits, (long)exp);
+    bad++;
+  } else if (!more && len > 1) {
+    mp_exp_t e;
+    char *fewer = mpfr_get_str(NULL, &e, base, len - 1, x, MPFR_RNDN);
+    if (readsAs(x, fewer, e, base)) {
+      fprintf(stderr, "error: base %d digits %s e%ld, but %s e%ld read back too\n", base, digits,
+              (long)exp, fewer, (long)e);
+      bad++;
+    }
+    mpfr_free_str(fewer);
+  }
+  free(digits);
+  mpfr_clear(exact);
+  mpfr_clear(x);
+  return bad;
+}
+
+static int checkLines() {
+  int bad = 0;
+  for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+    struct Value v;
+    valueInitZ(&v);
+    v = calculate(lines[i][0], v);
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&buf, &len);
+    struct Format format = {.base = 10};
+    printValue(out, v, &format);
+    fclose(out);
+    valueClear(&v);
+    if (strcmp(buf, lines[i][1])) {
+      fprintf(stderr, "error: %s printed %s", lines[i][0], buf);
+      bad++;
+    }
+    free(buf);
+  }
+  return bad;
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 2000;
+  seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+  gmp_randstate_t rand;
+  gmp_randinit_default(rand);
+  gmp_randseed_ui(rand, seed);
+  int failed = 0;
+  for (int p = 0; p < 4; p++) {
+    mpf_t f;
+    mpf_init2(f, precs[p]);
+    for (int i = 0; i < count && failed < 20; i++) {
+      randomFloat(rand, f, precs[p]);
+      for (int b = 0; b < 4; b++) {
+        failed += check(f, bases[b]);
+      }
+    }
+    mpf_clear(f);
+  }
+  gmp_randclear(rand);
+  int lineFailed = checkLines();
+  printf("%d floats, %d don't read back or aren't the shortest, %d lines print differently\n",
+         count * 4, failed, lineFailed);
+  return failed || lineFailed ? 1 : 0;
+}
@@ -0,0 +1,207 @@
+/** @copyright 2025 Sean Kasun */
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <gmp.h>
+#include "calculator.h"
+
+/**
+ * Runs a mix of valid and invalid lines through calculate() over and over,
+ * in each of the modes that take different paths, and fails if memory
+ * grows once the first rounds have warmed up the caches.  The blocks GMP
+ * and MPFR hold have to come back to the same count after every round, and
+ * malloc's bytes in use and RSS can't creep up.  Before that, it checks
+ * that integer leaves allocate only their integer and that a repeated
+ * subexpression is worked out once, by counting GMP's allocations.
+ *
+ *   zx_soak [lines]
+ */
+
+#define WARMUP_ROUNDS 20  // enough for the 1000 results of history to fill up
+#define HEAP_SLACK (64 << 10)  // $ and x aren't quite the same size every round
+#define RSS_SLACK (256 << 10)  // pages the allocator may hang on to
+#define COPIES 50  // terms in each line the allocation checks use
+
+static const char *lines[] = {
+  "1 + 2",
+  "0x723 * 4",
+  "5. / 2",
+  "5 % 2.5",
+  "2 ** 100",
+  "sqrt 2",
+  "sin 0.5 + cos 0.5 * tan 0.5",
+  "floor 1.9 + ceil 1.4 + round 0.5",
+  "(1 << 200) >> 3",
+  "~0xff & 61 | 0x20 ^ 7",
+  "popcnt 0xff + bitfield(0x1234, 4, 8)",
+  "0xf0 pdep 0xff00 pext 0xf0f0",
+  "'a' + 1",
+  "\"hi\" + 1",
+  "pi * 2",
+  "$ * 2",
+  "$2 - $1",
+  "x = 6371",
+  "2 * pi * x",
+  "x = x + 1",
+  // errors, each from a different place in the parser or evaluator
+  "(3.5 * 2",
+  "1 / 0",
+  "5 % 0",
+  "sqrt -1",
+  "3 +",
+  "* 4",
+  "'ab",
+  "'",
+  "\"unterminated",
+  "\"\\xzz\"",
+  "bitfield(1, 2",
+  "popcnt -1",
+  "1 << -1",
+  "nosuchname",
+  "pi = 3",
+  "sin = 3",
+  "1 2 3",
+  "((((((((((1))))))))))",
+  ")",
+  "",
+};
+
+static size_t gmpLive = 0;  // blocks GMP and MPFR hold right now
+static size_t gmpAllocs = 0;  // blocks they ever asked for
+
+static void *countAlloc(size_t n) {
+  gmpLive++;
+  gmpAllocs++;
+  return malloc(n);
+}
+
+static void *countRealloc(void *p, size_t old, size_t n) {
+  (void)old;
+  return realloc(p, n);
+}
+
+static void countFree(void *p, size_t n) {
+  (void)n;
+  gmpLive--;
+  free(p);
+}
+
+static size_t rss() {
+  long pages = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f) {
+    if (fscanf(f, "%*d %ld", &pages) != 1) {
+      pages = 0;
+    }
+    fclose(f);
+  }
+  return pages * sysconf(_SC_PAGESIZE);
+}
+
+// blocks GMP allocates to work out line, counting the second run since the first sets up constants
+static size_t allocations(const char *line) {
+  size_t start = 0;
+  for (int i = 0; i < 2; i++) {
+    struct Value v;
+    valueInitZ(&v);
+    start = gmpAllocs;
+    v = calculate(line, v);
+    valueClear(&v);
+  }
+  return gmpAllocs - start;
+}
+
+/**
+ * Only the live member of a value is initialized, so an integer leaf costs
+ * one block for its limbs and no float.  Identical subtrees are shared, so
+ * COPIES of one sine cost little more than the additions between them,
+ * while COPIES different sines cost a sine apiece.
+ */
+static bool checkAllocations() {
+  char ints[COPIES * 16] = "", same[COPIES * 32] = "", different[COPIES * 32] = "";
+  for (int i = 0; i < COPIES; i++) {
+    const char *plus = i ? " + " : "";
+    sprintf(ints + strlen(ints), "%s%d", plus, 1000 + i);
+    sprintf(same + strlen(same), "%ssin(sqrt 2 * 3.)", plus);
+    sprintf(different + strlen(different), "%ssin(sqrt %d * 3.)", plus, 2 + i);
+  }
+  size_t intBlocks = allocations(ints);
+  size_t sameBlocks = allocations(same);
+  size_t differentBlocks = allocations(different);
+  printf("%d integer leaves %zu GMP blocks, %d shared sines %zu, %d different sines %zu\n",
+         COPIES, intBlocks, COPIES, sameBlocks, COPIES, differentBlocks);
+  bool ok = true;
+  if (intBlocks > COPIES) {
+    fprintf(stderr, "error: %d integer leaves took %zu GMP blocks\n", COPIES, intBlocks);
+    ok = false;
+  }
+  if (sameBlocks * 2 > differentBlocks) {
+    fprintf(stderr, "error: %d shared sines took %zu GMP blocks, %d different ones %zu\n",
+            COPIES, sameBlocks, COPIES, differentBlocks);
+    ok = false;
+  }
+  return ok;
+}
+
+// every line once in each mode, which leaves the same state behind each time
+static long runRound(struct Value *prev) {
+  long count = 0;
+  mpz_t n;
+  mpz_init_set_ui(n, 1000000007);
+  for (int mode = 0; mode < 5; mode++) {
+    calcSetWidth(mode == 1 ? 32 : 0, true);
+    calcSetDigits(mode == 2 ? 25 : mode == 4 ? 12 : 0, 10);  // 12 goes by way of doubles
+    calcSetModulus(mode == 3 ? n : NULL);
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+      *prev = calculate(lines[i], *prev);
+      if (!calcError()) {
+        calcRemember(*prev);
+      }
+      count++;
+    }
+  }
+  calcSetModulus(NULL);
+  calcSetDigits(0, 10);
+  calcSetWidth(0, false);
+  mpz_clear(n);
+  // $ itself changes from round to round, so it goes back to 0
+  valueClear(prev);
+  valueInitZ(prev);
+  return count;
+}
+
+int main(int argc, char **argv) {
+  long wanted = argc > 1 ? atol(argv[1]) : 100000;
+  mp_set_memory_functions(countAlloc, countRealloc, countFree);
+  if (!checkAllocations()) {
+    return 1;
+  }
+  struct Value prev;
+  valueInitZ(&prev);
+  long count = 0;
+  for (int i = 0; i < WARMUP_ROUNDS; i++) {
+    count += runRound(&prev);
+  }
+  size_t startRss = rss();
+  size_t startHeap = mallinfo2().uordblks;
+  size_t startGmp = gmpLive;
+  int rounds = WARMUP_ROUNDS;
+  bool ok = true;
+  while (count < wanted && ok) {
+    count += runRound(&prev);
+    rounds++;
+    size_t heap = mallinfo2().uordblks;
+    if (heap > startHeap + HEAP_SLACK || gmpLive != startGmp || rss() > startRss + RSS_SLACK) {
+      fprintf(stderr, "error: After %d rounds, heap %zu bytes (was %zu), GMP %zu blocks (was %zu), "
+              "RSS %zuK (was %zuK)\n", rounds, heap, startHeap, gmpLive, startGmp,
+              rss() >> 10, startRss >> 10);
+      ok = false;
+    }
+  }
+  valueClear(&prev);
+  printf("%ld lines in %d rounds, heap %zu bytes, GMP %zu blocks, RSS %zuK\n", count, rounds,
+         startHeap, startGmp, startRss >> 10);
+  return ok ? 0 : 1;
+}
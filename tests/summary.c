@@ -0,0 +1,196 @@
+/** @copyright 2025 Sean Kasun */
+#define _GNU_SOURCE  // for the pseudo-terminal calls
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <gmp.h>
+#include "calculator.h"
+#include "output.h"
+
+/**
+ * Checks how huge integers are summarized at the prompt.  Random integers
+ * around the summary length, and the powers on either side of a digit
+ * count, have to show the same first and last digits and the same count as
+ * printing them in full, in every base.  Then it runs zx on a terminal and
+ * checks that a huge result is summarized and that full prints all of it.
+ *
+ *   zx_summary [numbers per base] [seed]
+ */
+
+#define SUMMARY 1000  // the digits main.c summarizes past
+#define ENDS 16  // digits shown at each end
+
+extern char **environ;
+
+static const int bases[] = {10, 16, 8, 2};
+
+static unsigned long seed;
+
+static unsigned pick(unsigned n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (seed >> 33) % n;
+}
+
+// how printValue() shows z, without the newline
+static char *printed(mpz_srcptr z, int base, int summary) {
+  struct Value v;
+  valueInitZ(&v);
+  mpz_set(v.z, z);
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream(&buf, &len);
+  struct Format format = {.base = base, .summary = summary};
+  printValue(out, v, &format);
+  fclose(out);
+  valueClear(&v);
+  buf[strcspn(buf, "\n")] = 0;
+  return buf;
+}
+
+// the summary of z, cut out of the whole thing
+static char *summarized(mpz_srcptr z, int base) {
+  char *full = printed(z, base, 0);
+  size_t len = strlen(full);
+  size_t start = (mpz_sgn(z) < 0) + (base == 10 ? 0 : 2);  // the sign and prefix
+  size_t count = len - start;
+  if (count <= SUMMARY) {
+    return full;
+  }
+  char *s = malloc(len + 64);
+  sprintf(s, "%.*s...%s (%zu digits)", (int)(start + ENDS), full, full + len - ENDS, count);
+  free(full);
+  return s;
+}
+
+static int check(mpz_srcptr z, int base) {
+  char *want = summarized(z, base);
+  char *got = printed(z, base, SUMMARY);
+  int bad = strcmp(want, got) != 0;
+  if (bad) {
+    fprintf(stderr, "error: base %d summary %s, should be %s\n", base, got, want);
+  }
+  free(want);
+  free(got);
+  return bad;
+}
+
+static int checkBase(gmp_randstate_t rand, int base, int count) {
+  int bad = 0;
+  mpz_t z, zeros;
+  mpz_init(z);
+  mpz_init(zeros);
+  // the numbers either side of SUMMARY + 1 and more digits
+  for (int digits = SUMMARY - 1; digits <= SUMMARY + 2 && !bad; digits++) {
+    mpz_ui_pow_ui(z, base, digits);
+    bad += check(z, base);
+    mpz_sub_ui(z, z, 1);
+    bad += check(z, base);
+    mpz_neg(z, z);
+    bad += check(z, base);
+  }
+  for (int i = 0; i < count && !bad; i++) {
+    int digits = SUMMARY - 10 + pick(pick(4) ? 50 : 5000);
+    mpz_ui_pow_ui(z, base, digits);
+    mpz_urandomm(z, rand, z);
+    if (pick(4) == 0) {  // zeros at the end, which the tail has to keep
+      mpz_ui_pow_ui(zeros, base, ENDS - 4 + pick(8));
+      mpz_mul(z, z, zeros);
+    }
+    if (pick(2)) {
+      mpz_neg(z, z);
+    }
+    bad += check(z, base);
+  }
+  mpz_clear(zeros);
+  mpz_clear(z);
+  return bad;
+}
+
+// everything zx prints on a terminal for input
+static char *onTerminal(const char *input) {
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) || unlockpt(master)) {
+    return NULL;
+  }
+  int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, slave, 0);
+  posix_spawn_file_actions_adddup2(&actions, slave, 1);
+  posix_spawn_file_actions_adddup2(&actions, slave, 2);
+  posix_spawn_file_actions_addclose(&actions, master);
+  char *args[] = {ZX_PATH, NULL};
+  char *env[] = {"TERM=dumb", NULL};  // plain readline, no preview
+  pid_t pid;
+  bool ok = slave >= 0 && !posix_spawn(&pid, args[0], &actions, NULL, args, env);
+  posix_spawn_file_actions_destroy(&actions);
+  if (slave >= 0) {
+    close(slave);
+  }
+  char *buf = NULL;
+  size_t len = 0;
+  if (ok) {
+    FILE *out = open_memstream(&buf, &len);
+    ok = write(master, input, strlen(input)) == (ssize_t)strlen(input);
+    char chunk[4096];
+    ssize_t n;
+    // reads fail once zx exits and the terminal closes
+    while ((n = read(master, chunk, sizeof(chunk))) > 0) {
+      fwrite(chunk, 1, n, out);
+    }
+    fclose(out);
+    int status;
+    ok = waitpid(pid, &status, 0) >= 0 && WIFEXITED(status) && !WEXITSTATUS(status) && ok;
+  }
+  close(master);
+  if (!ok) {
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+static bool checkTerminal() {
+  mpz_t z;
+  mpz_init(z);
+  mpz_setbit(z, 5000);
+  mpz_add_ui(z, z, 1);
+  char *want = summarized(z, 10), *full = printed(z, 10, 0);
+  char *got = onTerminal("(1 << 5000) + 1\nfull\nquit\n");
+  bool ok = got != NULL;
+  if (!ok) {
+    fprintf(stderr, "error: Can't run %s on a terminal\n", ZX_PATH);
+  } else if (!strstr(got, want)) {
+    fprintf(stderr, "error: zx didn't summarize (1 << 5000) + 1 as %s\n", want);
+    ok = false;
+  } else if (!strstr(got, full)) {
+    fprintf(stderr, "error: full didn't print all %zu digits of (1 << 5000) + 1\n", strlen(full));
+    ok = false;
+  }
+  free(got);
+  free(full);
+  free(want);
+  mpz_clear(z);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 200;
+  seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+  gmp_randstate_t rand;
+  gmp_randinit_default(rand);
+  gmp_randseed_ui(rand, seed);
+  int failed = 0;
+  for (int i = 0; i < 4; i++) {
+    failed += checkBase(rand, bases[i], count);
+  }
+  gmp_randclear(rand);
+  bool ok = checkTerminal();
+  printf("%d numbers, %d bases summarize differently, terminal %s\n", count * 4, failed,
+         ok ? "ok" : "failed");
+  return failed || !ok ? 1 : 0;
+}
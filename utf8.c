@@ -0,0 +1,167 @@
+/** @copyright 2025 Sean Kasun */
+#include "utf8.h"
+#include <stdbool.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static bool continuation(uint8_t c) {
+  return (c & 0xc0) == 0x80;
+}
+
+/**
+ * Decodes the code point at s.  Returns its length in bytes, or 0 if it is
+ * truncated, overlong, a surrogate or past U+10FFFF.
+ */
+int utf8DecodeOne(const char *s, size_t len, uint32_t *cp) {
+  const uint8_t *p = (const uint8_t *)s;
+  if (len == 0) {
+    return 0;
+  }
+  if (p[0] < 0x80) {
+    *cp = p[0];
+    return 1;
+  }
+  if (p[0] < 0xc2) {  // stray continuation, or an overlong 2 byte sequence
+    return 0;
+  }
+  if (p[0] < 0xe0) {
+    if (len < 2 || !continuation(p[1])) {
+      return 0;
+    }
+    *cp = (p[0] & 0x1f) << 6 | (p[1] & 0x3f);
+    return 2;
+  }
+  if (p[0] < 0xf0) {
+    if (len < 3 || !continuation(p[1]) || !continuation(p[2])) {
+      return 0;
+    }
+    uint32_t v = (p[0] & 0xf) << 12 | (p[1] & 0x3f) << 6 | (p[2] & 0x3f);
+    if (v < 0x800 || (v >= 0xd800 && v < 0xe000)) {
+      return 0;
+    }
+    *cp = v;
+    return 3;
+  }
+  if (p[0] < 0xf5) {
+    if (len < 4 || !continuation(p[1]) || !continuation(p[2]) || !continuation(p[3])) {
+      return 0;
+    }
+    uint32_t v = (p[0] & 0x7) << 18 | (p[1] & 0x3f) << 12 | (p[2] & 0x3f) << 6 | (p[3] & 0x3f);
+    if (v < 0x10000 || v > 0x10ffff) {
+      return 0;
+    }
+    *cp = v;
+    return 4;
+  }
+  return 0;
+}
+
+/**
+ * Decodes s into out until the first backslash or stop byte, which must be
+ * ascii, or the first malformed sequence.  out needs room for len code
+ * points.  Returns the number of bytes decoded.
+ */
+size_t utf8Decode(const char *s, size_t len, char stop, uint32_t *out, size_t *count) {
+  size_t i = 0, n = 0;
+  while (i < len) {
+#ifdef __SSE2__
+    // runs of plain ascii are widened 16 bytes at a time
+    __m128i stops = _mm_set1_epi8(stop);
+    __m128i slashes = _mm_set1_epi8('\\');
+    __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= len) {
+      __m128i bytes = _mm_loadu_si128((const __m128i *)(s + i));
+      __m128i special = _mm_or_si128(_mm_cmpeq_epi8(bytes, stops), _mm_cmpeq_epi8(bytes, slashes));
+      if (_mm_movemask_epi8(_mm_or_si128(bytes, special))) {
+        break;
+      }
+      __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+      __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+      _mm_storeu_si128((__m128i *)(out + n), _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128((__m128i *)(out + n + 4), _mm_unpackhi_epi16(lo, zero));
+      _mm_storeu_si128((__m128i *)(out + n + 8), _mm_unpacklo_epi16(hi, zero));
+      _mm_storeu_si128((__m128i *)(out + n + 12), _mm_unpackhi_epi16(hi, zero));
+      i += 16;
+      n += 16;
+    }
+    if (i == len) {
+      break;
+    }
+#endif
+    // then one character, and the rest of any run of multibyte ones
+    do {
+      if (s[i] == stop || s[i] == '\\') {
+        *count = n;
+        return i;
+      }
+      int used = utf8DecodeOne(s + i, len - i, out + n);
+      if (!used) {
+        *count = n;
+        return i;
+      }
+      i += used;
+      n++;
+    } while (i < len && (s[i] & 0x80));
+  }
+  *count = n;
+  return i;
+}
+
+/**
+ * Encodes code points as utf8, with U+FFFD in place of surrogates and
+ * anything past U+10FFFF.  out needs room for 4 bytes per code point.
+ * Returns the number of bytes written.
+ */
+size_t utf8Encode(const uint32_t *cps, size_t count, char *out) {
+  uint8_t *p = (uint8_t *)out;
+  size_t i = 0;
+  while (i < count) {
+#ifdef __SSE2__
+    // runs of plain ascii are narrowed 16 code points at a time
+    __m128i high = _mm_set1_epi32(~0x7f);
+    __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= count) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(cps + i));
+      __m128i b = _mm_loadu_si128((const __m128i *)(cps + i + 4));
+      __m128i c = _mm_loadu_si128((const __m128i *)(cps + i + 8));
+      __m128i d = _mm_loadu_si128((const __m128i *)(cps + i + 12));
+      __m128i all = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(all, high), zero)) != 0xffff) {
+        break;
+      }
+      __m128i words = _mm_packs_epi32(a, b);
+      _mm_storeu_si128((__m128i *)p, _mm_packus_epi16(words, _mm_packs_epi32(c, d)));
+      p += 16;
+      i += 16;
+    }
+    if (i == count) {
+      break;
+    }
+#endif
+    do {
+      uint32_t v = cps[i++];
+      if (v < 0x80) {
+        *p++ = v;
+      } else if (v < 0x800) {
+        *p++ = 0xc0 | (v >> 6);
+        *p++ = 0x80 | (v & 0x3f);
+      } else {
+        if (v > 0x10ffff || (v >= 0xd800 && v < 0xe000)) {
+          v = 0xfffd;
+        }
+        if (v < 0x10000) {
+          *p++ = 0xe0 | (v >> 12);
+          *p++ = 0x80 | ((v >> 6) & 0x3f);
+          *p++ = 0x80 | (v & 0x3f);
+        } else {
+          *p++ = 0xf0 | (v >> 18);
+          *p++ = 0x80 | ((v >> 12) & 0x3f);
+          *p++ = 0x80 | ((v >> 6) & 0x3f);
+          *p++ = 0x80 | (v & 0x3f);
+        }
+      }
+    } while (i < count && cps[i] >= 0x80);
+  }
+  return p - (uint8_t *)out;
+}
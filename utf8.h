@@ -0,0 +1,9 @@
+/** @copyright 2025 Sean Kasun */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern int utf8DecodeOne(const char *s, size_t len, uint32_t *cp);
+extern size_t utf8Decode(const char *s, size_t len, char stop, uint32_t *out, size_t *count);
+extern size_t utf8Encode(const uint32_t *cps, size_t count, char *out);
@@ -0,0 +1,127 @@
+/** @copyright 2025 Sean Kasun */
+#include "wire.h"
+#include <gmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LENGTH_SIZE 4
+#define HEADER_SIZE 10  // kind, sign, exponent
+
+static void putLE(uint8_t *p, uint64_t v, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    p[i] = v >> (i * 8);
+  }
+}
+
+static uint64_t getLE(const uint8_t *p, int bytes) {
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; i++) {
+    v |= (uint64_t)p[i] << (i * 8);
+  }
+  return v;
+}
+
+static bool writeNumber(FILE *out, int kind, mpz_srcptr mag, int64_t exponent) {
+  size_t limbs = (mpz_sizeinbase(mag, 2) + 63) / 64;
+  size_t len = HEADER_SIZE + limbs * 8;
+  uint8_t *rec = malloc(LENGTH_SIZE + len);
+  putLE(rec, len, 4);
+  rec[4] = kind;
+  rec[5] = mpz_sgn(mag) < 0;
+  putLE(rec + 6, exponent, 8);
+  size_t count = 0;
+  mpz_export(rec + LENGTH_SIZE + HEADER_SIZE, &count, -1, 8, -1, 0, mag);
+  // zero exports nothing
+  memset(rec + LENGTH_SIZE + HEADER_SIZE + count * 8, 0, (limbs - count) * 8);
+  bool ok = fwrite(rec, 1, LENGTH_SIZE + len, out) == LENGTH_SIZE + len;
+  free(rec);
+  return ok;
+}
+
+bool wireWriteValue(FILE *out, struct Value v) {
+  if (!v.isF) {
+    return writeNumber(out, WireInt, v.z, 0);
+  }
+  // the mantissa limbs are an integer scaled by whole limbs
+  mpz_t mantissa;
+  int size = v.f->_mp_size;
+  int n = size < 0 ? -size : size;
+  mpz_roinit_n(mantissa, v.f->_mp_d, size);
+  int64_t exponent = n ? ((int64_t)v.f->_mp_exp - n) * GMP_NUMB_BITS : 0;
+  return writeNumber(out, WireFloat, mantissa, exponent);
+}
+
+bool wireWriteText(FILE *out, int kind, const char *text, size_t len) {
+  uint8_t header[LENGTH_SIZE + 1];
+  putLE(header, len + 1, 4);
+  header[4] = kind;
+  return fwrite(header, 1, sizeof(header), out) == sizeof(header) &&
+    fwrite(text, 1, len, out) == len;
+}
+
+/**
+ * Reads the next record.  Numbers replace v, which must hold a valid value.
+ * Expressions and errors are returned in a newly allocated string that the
+ * caller frees.
+ */
+int wireRead(FILE *in, struct Value *v, char **text) {
+  uint8_t header[LENGTH_SIZE];
+  if (fread(header, 1, LENGTH_SIZE, in) != LENGTH_SIZE) {
+    return WireEnd;
+  }
+  size_t len = getLE(header, 4);
+  uint8_t *rec = malloc(len + 1);
+  if (len == 0 || fread(rec, 1, len, in) != len) {
+    free(rec);
+    return WireEnd;
+  }
+  int kind = rec[0];
+  switch (kind) {
+    case WireInt:
+    case WireFloat:
+      if (len < HEADER_SIZE || (len - HEADER_SIZE) % 8) {
+        kind = WireEnd;
+        break;
+      }
+      {
+        bool neg = rec[1];
+        int64_t exponent = getLE(rec + 2, 8);
+        mpz_t mag;
+        mpz_init(mag);
+        mpz_import(mag, (len - HEADER_SIZE) / 8, -1, 8, -1, 0, rec + HEADER_SIZE);
+        if (neg) {
+          mpz_neg(mag, mag);
+        }
+        valueClear(v);
+        v->isF = kind == WireFloat;
+        if (v->isF) {
+          // a default precision mpf holds two limbs more than its precision
+          mp_bitcnt_t bits = mpz_sizeinbase(mag, 2);
+          mp_bitcnt_t prec = mpf_get_default_prec();
+          mpf_init2(v->f, bits > prec + 2 * GMP_NUMB_BITS ? bits : prec);
+          mpf_set_z(v->f, mag);
+          if (exponent < 0) {
+            mpf_div_2exp(v->f, v->f, -exponent);
+          } else {
+            mpf_mul_2exp(v->f, v->f, exponent);
+          }
+          mpz_clear(mag);
+        } else {
+          v->z[0] = mag[0];
+        }
+      }
+      break;
+    case WireExpression:
+    case WireError:
+      *text = malloc(len);
+      memcpy(*text, rec + 1, len - 1);
+      (*text)[len - 1] = 0;
+      break;
+    default:
+      kind = WireEnd;
+      break;
+  }
+  free(rec);
+  return kind;
+}
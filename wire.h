@@ -0,0 +1,28 @@
+/** @copyright 2025 Sean Kasun */
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "calculator.h"
+
+/**
+ * Binary records for piping values between tools without going through text.
+ *
+ *   u32 length    bytes that follow this field
+ *   u8  kind      WireInt, WireFloat, WireExpression or WireError
+ *
+ * numbers continue with
+ *   u8  sign      1 if negative
+ *   i64 exponent  floats are limbs * 2^exponent, always 0 for integers
+ *   u64 limbs[]   magnitude, least significant first
+ *
+ * expressions and errors continue with their text, unterminated.
+ * Every field is little-endian.
+ */
+enum {
+  WireEnd = -1, WireInt, WireFloat, WireExpression, WireError,
+};
+
+extern bool wireWriteValue(FILE *out, struct Value v);
+extern bool wireWriteText(FILE *out, int kind, const char *text, size_t len);
+extern int wireRead(FILE *in, struct Value *v, char **text);